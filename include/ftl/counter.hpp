@@ -21,7 +21,7 @@ class Counter {
             ++(*counter_);
         }
     }
-    inline Counter(Counter &&c): counter_(c.counter_) {
+    inline Counter(Counter &&c) noexcept : counter_(c.counter_) {
         c.counter_ = nullptr;
     }
     inline ~Counter() {
@@ -151,7 +151,7 @@ struct Handler : BaseHandler {
      * single thread, not in parallel.
      */
     void triggerAsync(ARGS ...args) {
-        ftl::pool.push([this, c = std::move(ftl::Counter(&jobs_)), args...](int id) {
+        ftl::pool.post([this, c = std::move(ftl::Counter(&jobs_)), args...](int id) {
             bool hadFault = false;
             std::string faultMsg;
             std::unique_lock<std::shared_mutex> lk(mutex_);
@@ -179,7 +179,7 @@ struct Handler : BaseHandler {
     void triggerParallel(ARGS ...args) {
         std::unique_lock<std::shared_mutex> lk(mutex_);
         for (auto i = callbacks_.begin(); i != callbacks_.end(); ++i) {
-            ftl::pool.push([this, c = std::move(ftl::Counter(&jobs_)), f = i->second, args...](int id) {
+            ftl::pool.post([this, c = std::move(ftl::Counter(&jobs_)), f = i->second, args...](int id) {
                 try {
                     f(args...);
                 } catch (const ftl::exception &e) {
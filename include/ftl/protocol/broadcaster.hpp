@@ -8,6 +8,10 @@
 
 #include <list>
 #include <memory>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
 #include <ftl/protocol/streams.hpp>
 
 namespace ftl {
@@ -20,9 +24,32 @@ namespace protocol {
  */
 class Broadcast : public Stream {
  public:
+    /** Default number of packets queued for each child stream in concurrent mode. */
+    static constexpr size_t kDefaultQueueSize = 256;
+
     Broadcast();
     virtual ~Broadcast();
 
+    /**
+     * @brief Post to each child stream from its own thread, so a slow child
+     * does not delay the others. Packets are copied into a queue of the given
+     * size per child and posted in order. If a child's queue is full the
+     * packet is dropped for that child and counted, see kDropCount. Waits
+     * for posts in progress and for queued packets to be posted.
+     *
+     * @param enabled false to post to each child in turn from `post` (default)
+     * @param queue packets queued per child stream
+     */
+    void setConcurrent(bool enabled, size_t queue = kDefaultQueueSize);
+
+    inline bool isConcurrent() const { return concurrent_; }
+
+    /**
+     * @brief Packets dropped for each child stream in concurrent mode, in the
+     * same order as `streams()`. The kDropCount property gives the total.
+     */
+    std::vector<size_t> dropCounts() const;
+
     void add(const std::shared_ptr<Stream> &);
     void remove(const std::shared_ptr<Stream> &);
     void clear();
@@ -61,14 +88,34 @@ class Broadcast : public Stream {
     StreamType type() const override;
 
  private:
+    /** Queue of packets for one child stream and the thread posting them. */
+    struct Worker {
+        std::vector<ftl::protocol::PacketPair> slots;   // Ring buffer, slots are reused
+        size_t head = 0;
+        size_t size = 0;
+        bool running = true;
+        std::atomic_size_t drops = 0;
+        MUTEX mtx;
+        std::condition_variable cv;
+        std::thread thread;
+    };
+
     struct StreamEntry {
         std::shared_ptr<Stream> stream;
         ftl::Handle handle;
         ftl::Handle req_handle;
         ftl::Handle avail_handle;
+        std::unique_ptr<Worker> worker;
     };
 
     std::list<StreamEntry> streams_;
+    SHARED_MUTEX post_mtx_;     // Shared by post, held to change streams_ or workers
+    std::atomic_bool concurrent_ = false;
+    size_t queue_size_ = kDefaultQueueSize;
+
+    void _startWorker(StreamEntry &entry);
+    static void _stopWorker(Worker &worker);
+    bool _enqueue(Worker &worker, const ftl::protocol::StreamPacket &, const ftl::protocol::DataPacket &);
 };
 
 }
@@ -7,17 +7,22 @@
 #pragma once
 
 #include <map>
+#include <set>
 #include <list>
+#include <array>
+#include <atomic>
 #include <memory>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 #include <string>
 #include <ftl/protocol/streams.hpp>
 
 namespace ftl {
 namespace protocol {
 
-static constexpr size_t kMaxStreams = 5;
+/** Framesets a muxer can allocate, frameset 255 means all framesets. */
+static constexpr size_t kMaxStreams = 255;
 
 /**
  * Combine multiple streams into a single stream. StreamPackets are modified
@@ -162,6 +167,37 @@ class Muxer : public Stream {
     std::list<std::shared_ptr<Stream>> streams() const;
 
  private:
+    struct StreamEntry;
+
+    /**
+     * Immutable FrameID lookup table, indexed by frameset and then source.
+     * Adding a mapping publishes a new table, so lookups never lock. Rows
+     * are shared between versions of a table.
+     */
+    template <typename T>
+    struct FrameTable {
+        std::array<std::shared_ptr<const std::array<T, 256>>, 256> framesets;
+
+        inline const T *find(FrameID id) const {
+            if (id.frameset() >= framesets.size()) return nullptr;
+            const auto &row = framesets[id.frameset()];
+            return (row) ? &(*row)[id.source()] : nullptr;
+        }
+    };
+
+    struct InputMapping {
+        FrameID local;
+        bool valid = false;
+    };
+
+    struct OutputMapping {
+        FrameID remote;
+        StreamEntry *entry = nullptr;
+    };
+
+    using InputTable = FrameTable<InputMapping>;
+    using OutputTable = FrameTable<OutputMapping>;
+
     struct StreamEntry {
         std::shared_ptr<Stream> stream;
         ftl::Handle handle;
@@ -170,18 +206,31 @@ class Muxer : public Stream {
         ftl::Handle err_handle;
         int id = 0;
         int fixed_fs = -1;
+        std::string uri;
+        std::atomic<const InputTable*> imap = nullptr;     // Stream specific ids to local ids
+        std::shared_ptr<const InputTable> imap_owner;
     };
 
     /** map between local and remote framsets, first 16 bits for stream id, second 16 bits for frameset */
     std::unordered_map<int, int> fsmap_;
     std::unordered_map<int, int> sourcecount_;
 
-    /* map between stream specific ids to local ids
-    *  packs stream id and frame id in uint64_t (first 32 bits for stream id, last for frameid) */
-    std::unordered_map<int64_t, FrameID> imap_;
+    /** Framesets of removed streams, allocated again before new ones */
+    std::set<int> free_framesets_;
 
     /** map between local FrameID and remote (FrameID, StreamEntry) pair */
-    std::unordered_map<FrameID, std::pair<FrameID, Muxer::StreamEntry*>> omap_;
+    std::atomic<const OutputTable*> omap_ = nullptr;
+    std::shared_ptr<const OutputTable> omap_owner_;
+
+    /**
+     * Replaced table versions, kept until destruction as lookups may still be
+     * using them. Tables only change when IDs are allocated or streams are
+     * removed, and rows are shared between versions.
+     */
+    std::vector<std::shared_ptr<const void>> retired_;
+
+    /** First stream added with each URI */
+    std::unordered_map<std::string, StreamEntry*> uris_;
 
     std::list<StreamEntry> streams_;
     mutable SHARED_MUTEX mutex_;
@@ -195,6 +244,19 @@ class Muxer : public Stream {
 
     /* On posting, map to output ID */
     std::pair<FrameID, StreamEntry*> _mapToOutput(FrameID id) const;
+
+    /* Copy of a table with one entry changed, published to `table` */
+    template <typename T>
+    void _publish(
+        std::atomic<const FrameTable<T>*> &table,
+        std::shared_ptr<const FrameTable<T>> &owner,
+        FrameID id,
+        const T &value);
+
+    /* Keep a replaced table for lookups still using it, must hold mutex_ */
+    void _retire(std::shared_ptr<const void> &&old);
+
+    const StreamEntry *_findEntry(const std::string &uri) const;
 };
 
 }  // namespace protocol
@@ -37,10 +37,33 @@ struct Header {
 };
 
 /**
- * Version 2 header padding for potential indexing use.
+ * Version 2 header padding for indexing use. In version 5 files the first
+ * value is the byte offset of an index block at the end of the file, or -1
+ * if there is none. Older writers left the remaining values uninitialised.
  */
 struct IndexHeader {
-    int64_t reserved[8];
+    int64_t index_offset = -1;
+    int64_t reserved[7] = {0};
+};
+
+/** File version where packets are grouped into blocks, see BlockHeader. */
+static constexpr uint8_t kBlockFTLVersion = 6;
+
+/** First value of a block header, "FTLB". */
+static constexpr uint32_t kBlockMagic = 0x424C5446;
+
+/**
+ * In version 6 files the packets following the IndexHeader are grouped into
+ * blocks, each starting with this header and followed by `size` bytes of
+ * packets. Blocks can be found and decoded independently of each other and
+ * the checksum is the CRC-32 of the packet bytes.
+ */
+struct BlockHeader {
+    uint32_t magic = kBlockMagic;
+    uint32_t size = 0;
+    uint32_t checksum = 0;
+    uint32_t count = 0;         // Number of packets
+    int64_t timestamp = 0;      // Timestamp of the first packet
 };
 
 /**
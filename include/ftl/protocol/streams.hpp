@@ -12,6 +12,8 @@
 #include <any>
 #include <unordered_map>
 #include <memory>
+#include <array>
+#include <atomic>
 #include <ftl/handle.hpp>
 #include <ftl/threads.hpp>
 #include <ftl/protocol/channels.hpp>
@@ -48,7 +50,7 @@ using StreamCallback = std::function<bool(const ftl::protocol::StreamPacket &, c
 enum struct StreamProperty {
     kInvalid = 0,
     kLooping,
-    kSpeed,
+    kSpeed,     /// Playback speed multiplier (float), 0 for as fast as possible
     kBitrate,
     kMaxBitrate,
     kAdaptiveBitrate,
@@ -69,6 +71,9 @@ enum struct StreamProperty {
     kDropCount,
     kAutoBufferAdjust, /// When enabled, buffer size may change runtime to minimize delay (and no underruns).
     kDisableBuffering, /// enable/disable buffering for specific channel
+    kDuration,  /// Length of a recording in milliseconds
+    kPosition,  /// Playback position in milliseconds from start, set to seek
+    kConcurrent,    /// Post to each child stream from its own thread (bool)
 };
 
 /**
@@ -273,7 +278,7 @@ class Stream {
     /**
      * Number of framesets in stream.
      */
-    inline size_t size() const { return state_.size(); }
+    inline size_t size() const { return size_; }
 
     /**
      * @brief Activate a frame. This allows availability information to be gathered
@@ -398,7 +403,8 @@ class Stream {
 
  private:
     struct FSState {
-        bool enabled = false;
+        std::atomic_bool present = false;
+        std::atomic_bool enabled = false;
         ftl::protocol::ChannelSet selected;
         ftl::protocol::ChannelSet availablePersistent;
         std::atomic_uint64_t availableLast = 0;
@@ -406,14 +412,29 @@ class Stream {
         // TODO(Nick): Add a name and metadata
     };
 
+    /** All sources of one frameset, each created on first use */
+    struct FSRow {
+        std::array<std::atomic<FSState*>, 256> sources = {};
+    };
+
     ftl::Handler<const ftl::protocol::StreamPacket&, const ftl::protocol::DataPacket&> cb_;
     ftl::Handler<const Request &> request_cb_;
     ftl::Handler<FrameID, ftl::protocol::Channel> avail_cb_;
     ftl::Handler<ftl::protocol::Error, const std::string&> error_cb_;
-    std::unordered_map<int, std::shared_ptr<FSState>> state_;
 
-    std::shared_ptr<FSState> _getState(FrameID id);
-    std::shared_ptr<FSState> _getState(FrameID id) const;
+    /**
+     * State indexed by frameset and source. Lookups are lock free, entries are
+     * only created under mtx_ and are never freed before the stream, a reset
+     * just marks them as not present.
+     */
+    std::array<std::atomic<FSRow*>, 256> state_ = {};
+    std::vector<std::unique_ptr<FSRow>> rows_;
+    std::vector<std::unique_ptr<FSState>> states_;
+    std::atomic_size_t size_ = 0;
+
+    FSState *_getState(FrameID id);
+    const FSState *_getState(FrameID id) const;
+    FSState *_makeState(FrameID id);  // mtx_ must be locked
 };
 
 using StreamPtr = std::shared_ptr<Stream>;
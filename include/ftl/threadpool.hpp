@@ -0,0 +1,228 @@
+/**
+ * @file threadpool.hpp
+ * @copyright Copyright (c) 2022 University of Turku, MIT License
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ftl {
+
+namespace detail {
+
+/**
+ * Move-only type erased `void(int)` job. Callables up to `kInlineSize` bytes
+ * are stored inside the task itself so that submitting them does not
+ * allocate, larger ones are moved to the heap.
+ */
+class PoolTask {
+ public:
+    static constexpr size_t kInlineSize = 96;
+
+    PoolTask() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, PoolTask>>>
+    explicit PoolTask(F &&f) {
+        using T = std::decay_t<F>;
+        if constexpr (isInline<T>()) {
+            new (&storage_) T(std::forward<F>(f));
+            ops_ = &InlineOps<T>::ops;
+        } else {
+            *reinterpret_cast<T**>(&storage_) = new T(std::forward<F>(f));
+            ops_ = &HeapOps<T>::ops;
+        }
+    }
+
+    PoolTask(PoolTask &&other) noexcept { take_(other); }
+
+    PoolTask &operator=(PoolTask &&other) noexcept {
+        if (this != &other) {
+            reset();
+            take_(other);
+        }
+        return *this;
+    }
+
+    PoolTask(const PoolTask &) = delete;
+    PoolTask &operator=(const PoolTask &) = delete;
+
+    ~PoolTask() { reset(); }
+
+    void reset() {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    void operator()(int id) { ops_->invoke(&storage_, id); }
+
+    template <typename T>
+    static constexpr bool isInline() {
+        return sizeof(T) <= kInlineSize && alignof(T) <= alignof(std::max_align_t) &&
+            std::is_nothrow_move_constructible_v<T>;
+    }
+
+ private:
+    struct Ops {
+        void (*invoke)(void*, int);
+        void (*move)(void*, void*);
+        void (*destroy)(void*);
+    };
+
+    template <typename T>
+    struct InlineOps {
+        static void invoke(void *p, int id) { (*static_cast<T*>(p))(id); }
+        static void move(void *src, void *dst) {
+            new (dst) T(std::move(*static_cast<T*>(src)));
+            static_cast<T*>(src)->~T();
+        }
+        static void destroy(void *p) { static_cast<T*>(p)->~T(); }
+        static constexpr Ops ops = {&invoke, &move, &destroy};
+    };
+
+    template <typename T>
+    struct HeapOps {
+        static void invoke(void *p, int id) { (**static_cast<T**>(p))(id); }
+        static void move(void *src, void *dst) { *static_cast<T**>(dst) = *static_cast<T**>(src); }
+        static void destroy(void *p) { delete *static_cast<T**>(p); }
+        static constexpr Ops ops = {&invoke, &move, &destroy};
+    };
+
+    void take_(PoolTask &other) {
+        if (other.ops_) {
+            other.ops_->move(&other.storage_, &storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    std::aligned_storage_t<kInlineSize, alignof(std::max_align_t)> storage_;
+    const Ops *ops_ = nullptr;
+};
+
+}  // namespace detail
+
+/**
+ * Work stealing thread pool. Each worker has its own fixed size job queue;
+ * jobs posted from a worker go to that worker's queue and other jobs are
+ * spread round robin. Idle workers steal from the other queues before
+ * sleeping. Jobs are functors of signature `ret func(int id)` where id is the
+ * index of the worker running it.
+ *
+ * `push` is compatible with the previous ctpl pool and returns a future. Use
+ * `post` when the result is not needed, it avoids the future and does not
+ * allocate for small functors.
+ */
+class ThreadPool {
+ public:
+    /** Jobs each worker queue can hold before spilling into a shared queue. */
+    static constexpr size_t kQueueSize = 1024;
+
+    ThreadPool() = default;
+    explicit ThreadPool(int nThreads) { start_(nThreads); }
+
+    /** Waits for all queued jobs to finish. */
+    ~ThreadPool() { stop(true); }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /** Number of worker threads, zero once stopped. */
+    int size() const { return nthreads_; }
+
+    /** Number of workers sleeping for lack of jobs. */
+    int n_idle() const { return idle_; }
+
+    /** Number of jobs queued but not yet started. */
+    size_t q_size() const { return pending_; }
+
+    /**
+     * Stop and start again with a new number of threads. Not thread-safe,
+     * nothing may be posted while restarting.
+     */
+    void restart(int nThreads);
+
+    /**
+     * Stop all worker threads. If isWait is true all queued jobs are run
+     * first, otherwise remaining jobs are discarded without running. Jobs
+     * already running are always completed.
+     */
+    void stop(bool isWait = false);
+
+    /**
+     * Queue a job without a result. Exceptions thrown by the job are logged
+     * and otherwise ignored.
+     */
+    template <typename F>
+    void post(F &&f) {
+        post_(detail::PoolTask(std::forward<F>(f)));
+    }
+
+    /**
+     * Queue a job, the returned future receives its result or exception.
+     * Extra arguments are bound after the worker id.
+     */
+    template <typename F, typename... Rest>
+    auto push(F &&f, Rest&&... rest) -> std::future<decltype(f(0, rest...))> {
+        using R = decltype(f(0, rest...));
+        auto pck = std::make_shared<std::packaged_task<R(int)>>(
+            std::bind(std::forward<F>(f), std::placeholders::_1, std::forward<Rest>(rest)...));
+        auto future = pck->get_future();
+        post([pck](int id) { (*pck)(id); });
+        return future;
+    }
+
+ private:
+    struct Worker {
+        std::mutex mtx;
+        std::vector<detail::PoolTask> jobs;
+        size_t head = 0;
+        size_t count = 0;
+        std::thread thread;
+
+        Worker() : jobs(kQueueSize) {}
+
+        bool push(detail::PoolTask &task);
+        bool pop(detail::PoolTask &task);
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    // Used when the target worker queue is full or there are no workers
+    std::mutex overflow_mtx_;
+    std::deque<detail::PoolTask> overflow_;
+
+    std::atomic_size_t next_ = 0;
+    std::atomic_size_t pending_ = 0;
+    std::atomic_int idle_ = 0;
+    std::atomic_int nthreads_ = 0;
+    std::atomic_bool stop_ = false;
+    std::atomic_bool done_ = false;
+
+    std::mutex sleep_mtx_;
+    std::condition_variable sleep_cv_;
+
+    void start_(int nThreads);
+    void post_(detail::PoolTask &&task);
+    bool take_(size_t index, detail::PoolTask &task);
+    void run_(size_t index);
+    void clear_();
+};
+
+}  // namespace ftl
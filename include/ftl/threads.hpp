@@ -8,7 +8,7 @@
 
 #include <mutex>
 #include <shared_mutex>
-#include <ftl/lib/ctpl_stl.hpp>
+#include <ftl/threadpool.hpp>
 
 #define POOL_SIZE 10
 
@@ -82,7 +82,7 @@ namespace ftl {
 
 void set_thread_name(const std::string& name);
 
-extern ctpl::thread_pool pool;
+extern ftl::ThreadPool pool;
 
 namespace threads {
 
@@ -94,7 +94,7 @@ private:
 
     template<typename T>
     void add_lk_(T func) {
-        pool.push([this, func=std::move(func)](int){
+        pool.post([this, func=std::move(func)](int){
             try {
                 func();
             }
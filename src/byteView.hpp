@@ -0,0 +1,49 @@
+/**
+ * @file byteView.hpp
+ * @copyright Copyright (c) 2022 University of Turku, MIT License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <msgpack.hpp>
+
+namespace ftl {
+namespace net {
+
+/**
+ * Non-owning view of binary data in a received message. Can be used as an RPC
+ * handler argument instead of std::vector<uint8_t> to avoid copying the data,
+ * it is only valid until the handler returns (the message buffer is kept alive
+ * by its msgpack::object_handle until then). Packs as msgpack bin.
+ */
+struct ByteView {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+    const uint8_t *begin() const { return data; }
+    const uint8_t *end() const { return data + size; }
+    bool empty() const { return size == 0; }
+
+    void msgpack_unpack(const msgpack::object &o) {
+        if (o.type == msgpack::type::BIN) {
+            data = reinterpret_cast<const uint8_t*>(o.via.bin.ptr);
+            size = o.via.bin.size;
+        } else if (o.type == msgpack::type::STR) {
+            data = reinterpret_cast<const uint8_t*>(o.via.str.ptr);
+            size = o.via.str.size;
+        } else {
+            throw msgpack::type_error();
+        }
+    }
+
+    template <typename Packer>
+    void msgpack_pack(Packer &pk) const {
+        pk.pack_bin(static_cast<uint32_t>(size));
+        pk.pack_bin_body(reinterpret_cast<const char*>(data), static_cast<uint32_t>(size));
+    }
+};
+
+}  // namespace net
+}  // namespace ftl
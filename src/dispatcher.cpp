@@ -17,6 +17,28 @@ using std::vector;
 using std::string;
 using std::optional;
 
+// Results are created here and released once sent, reused for every call
+// so that dispatch does not allocate. Per thread as peers may dispatch in
+// parallel; a handler may dispatch recursively but results only exist after
+// the handler has returned.
+static thread_local msgpack::zone result_zone;
+
+// Method names are copied here for lookup, it keeps its capacity so that
+// long names (URIs) do not allocate either. Not valid once a handler runs.
+static thread_local std::string name_buffer;
+
+static const std::string &methodName(const msgpack::object &method) {
+    if (method.type != msgpack::type::STR) throw FTL_Error("Bad message format");
+    name_buffer.assign(method.via.str.ptr, method.via.str.size);
+    return name_buffer;
+}
+
+// Only used in error messages
+static std::string methodLabel(const msgpack::object &method) {
+    if (method.type == msgpack::type::STR) return std::string(method.via.str.ptr, method.via.str.size);
+    return "#" + std::to_string(method.via.u64);
+}
+
 std::string object_type_to_string(const msgpack::type::object_type t) {
     switch (t) {
         case msgpack::type::object_type::NIL: return "NIL";
@@ -42,8 +64,8 @@ Dispatcher::~Dispatcher() {
 vector<string> Dispatcher::getBindings() const {
     SHARED_LOCK(mutex_, lk);
     vector<string> res;
-    for (auto x : funcs_) {
-        res.push_back(x.first);
+    for (const auto &x : ids_) {
+        if (funcs_[x.second]) res.push_back(x.first);
     }
     return res;
 }
@@ -52,9 +74,21 @@ void Dispatcher::unbind(const std::string &name) {
     // Write lock on mutex_ necessary, as there is no other way to synchronize on any ongoing calls. 
     // A read lock is held by any rpc call (in dispatch()), so this method will block if any calls busy.
     UNIQUE_LOCK(mutex_, lk);
-    auto i = funcs_.find(name);
-    if (i != funcs_.end()) {
-        funcs_.erase(i);
+    auto i = ids_.find(name);
+    if (i != ids_.end()) {
+        // Id is kept, peers may still use it
+        funcs_[i->second] = nullptr;
+    }
+}
+
+void Dispatcher::_insert(const std::string &name, adaptor_type &&func) {
+    auto i = ids_.find(name);
+    if (i != ids_.end()) {
+        funcs_[i->second] = std::move(func);
+    } else {
+        if (funcs_.size() >= kParentId) throw FTL_Error("Too many RPC bindings");
+        ids_.emplace(name, static_cast<uint32_t>(funcs_.size()));
+        funcs_.push_back(std::move(func));
     }
 }
 
@@ -106,66 +140,99 @@ void ftl::net::Dispatcher::dispatch_call(PeerBase &s, const msgpack::object &msg
     // TODO(Nick): proper validation of protocol (and responding to it)
     auto &&type = std::get<0>(the_call);
     auto &&id = std::get<1>(the_call);
-    auto &&name = std::get<2>(the_call);
+    auto &&method = std::get<2>(the_call);
     auto &&args = std::get<3>(the_call);
     // assert(type == 0);
-    //LOG(INFO) << "RPC call (remote): " << name;
 
     if (type == 0) {
-        auto func = _locateHandler(name);
+        auto func = _locateHandler(methodName(method));
 
         if (func) {
             try {
-                auto result = (*func)(s, args);
-                s._sendResponse(id, result->get());
+                auto result = (*func)(s, args, result_zone);
+                s._sendResponse(id, result);
+                result_zone.clear();
             } catch (const std::exception &e) {
+                result_zone.clear();
                 s._sendErrorResponse(id, msgpack::object(e.what()));
             }
         } else {
-            throw FTL_Error("No binding found for " << name);
+            throw FTL_Error("No binding found for " << methodLabel(method));
         }
     } else {
         throw FTL_Error("Unrecognised message type: " << type);
     }
 }
 
-optional<Dispatcher::adaptor_type> ftl::net::Dispatcher::_locateHandler(const std::string &name) const {
+optional<uint32_t> ftl::net::Dispatcher::_locateId(const std::string &name) const {
     //SHARED_LOCK(mutex_, lk);
-    auto it_func = funcs_.find(name);
-    if (it_func == funcs_.end()) {
-        if (parent_ != nullptr) {
-            return parent_->_locateHandler(name);
-        } else {
-            return {};
-        }
-    } else {
-        return it_func->second;
+    auto it = ids_.find(name);
+    if (it != ids_.end() && funcs_[it->second]) {
+        return it->second;
+    }
+    if (parent_ != nullptr) {
+        auto id = parent_->_locateId(name);
+        if (id) return *id | kParentId;
+    }
+    return {};
+}
+
+const Dispatcher::adaptor_type *ftl::net::Dispatcher::_locateHandler(uint32_t id) const {
+    //SHARED_LOCK(mutex_, lk);
+    if (id & kParentId) {
+        return (parent_) ? parent_->_locateHandler(id & ~kParentId) : nullptr;
+    }
+    return (id < funcs_.size() && funcs_[id]) ? &funcs_[id] : nullptr;
+}
+
+const Dispatcher::adaptor_type *ftl::net::Dispatcher::_locateHandler(const std::string &name) const {
+    auto id = _locateId(name);
+    return (id) ? _locateHandler(*id) : nullptr;
+}
+
+optional<uint32_t> ftl::net::Dispatcher::getMethodId(const std::string &name) const {
+    SHARED_LOCK(mutex_, lk);
+    std::shared_lock<std::shared_mutex> lk2;
+    if (parent_) {
+        lk2 = std::shared_lock<std::shared_mutex>(parent_->mutex_);
     }
+    return _locateId(name);
 }
 
 bool ftl::net::Dispatcher::isBound(const std::string &name) const {
     SHARED_LOCK(mutex_, lk);
-    return funcs_.find(name) != funcs_.end();
+    auto it = ids_.find(name);
+    return it != ids_.end() && funcs_[it->second];
 }
 
 void ftl::net::Dispatcher::dispatch_notification(PeerBase &peer_instance, msgpack::object const &msg) {
-    notification_t the_call;
-    msg.convert(the_call);
-
     // TODO(Nick): proper validation of protocol (and responding to it)
-    // auto &&type = std::get<0>(the_call);
-    // assert(type == static_cast<uint8_t>(request_type::notification));
+    // Message type (element 0) is not used.
+
+    // Method is a name or an id this peer has given to the sender earlier
+    const msgpack::object &method = msg.via.array.ptr[1];
+    const msgpack::object &args = msg.via.array.ptr[2];
+    if (args.type != msgpack::type::ARRAY) throw FTL_Error("Bad message format");
 
-    auto &&name = std::get<1>(the_call);
-    auto &&args = std::get<2>(the_call);
+    const adaptor_type *binding = nullptr;
+
+    if (method.type == msgpack::type::POSITIVE_INTEGER) {
+        binding = _locateHandler(method.as<uint32_t>());
+    } else {
+        const std::string &name = methodName(method);
+        auto id = _locateId(name);
+        if (id) {
+            binding = _locateHandler(*id);
+            peer_instance._announceMethodId(name, *id);
+        }
+    }
 
     //LOG(INFO) << "RPC notify (remote): " << name;
-    
-    auto binding = _locateHandler(name);
 
     if (binding) {
         try {
-            auto result = (*binding)(peer_instance, args);
+            (*binding)(peer_instance, args, result_zone);
+            result_zone.clear();
         } catch (const int &e) {
             throw &e;
         } catch (const std::bad_cast &e) {
@@ -176,10 +243,10 @@ void ftl::net::Dispatcher::dispatch_notification(PeerBase &peer_instance, msgpac
             }
             throw FTL_Error("Bad cast, got: " << args_str);
         } catch (const std::exception &e) {
-            throw FTL_Error("Exception for '" << name << "' - " << e.what());
+            throw FTL_Error("Exception for '" << methodLabel(method) << "' - " << e.what());
         }
     } else {
-        throw FTL_Error("Missing handler for incoming message (" << name << ")");
+        throw FTL_Error("Missing handler for incoming message (" << methodLabel(method) << ")");
     }
 }
 
@@ -192,8 +259,8 @@ void ftl::net::Dispatcher::enforce_arg_count(std::string const &func, std::size_
 
 void ftl::net::Dispatcher::enforce_unique_name(std::string const &func) {
     SHARED_LOCK(mutex_, lk);
-    auto pos = funcs_.find(func);
-    if (pos != end(funcs_)) {
+    auto it = ids_.find(func);
+    if (it != ids_.end() && funcs_[it->second]) {
         throw FTL_Error("RPC non unique binding for '" << func << "'");
     }
 }
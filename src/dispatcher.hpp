@@ -95,12 +95,11 @@ class Dispatcher {
                           ftl::internal::false_ const &) {
         enforce_unique_name(name);
         UNIQUE_LOCK(mutex_, lk);
-        funcs_.insert(
-            std::make_pair(name, [func, name](ftl::net::PeerBase &p, msgpack::object const &args) {
-                enforce_arg_count(name, 0, args.via.array.size);
-                func();
-                return std::make_unique<msgpack::object_handle>();
-            }));
+        _insert(name, [func, name](ftl::net::PeerBase &p, msgpack::object const &args, msgpack::zone &z) {
+            enforce_arg_count(name, 0, args.via.array.size);
+            func();
+            return msgpack::object();
+        });
     }
 
     /**
@@ -118,15 +117,14 @@ class Dispatcher {
 
         enforce_unique_name(name);
         UNIQUE_LOCK(mutex_, lk);
-        funcs_.insert(
-            std::make_pair(name, [func, name](ftl::net::PeerBase &p, msgpack::object const &args) {
-                constexpr int args_count = std::tuple_size<args_type>::value;
-                enforce_arg_count(name, args_count, args.via.array.size);
-                args_type args_real;
-                args.convert(args_real);
-                ftl::internal::call(func, args_real);
-                return std::make_unique<msgpack::object_handle>();
-            }));
+        _insert(name, [func, name](ftl::net::PeerBase &p, msgpack::object const &args, msgpack::zone &z) {
+            constexpr int args_count = std::tuple_size<args_type>::value;
+            enforce_arg_count(name, args_count, args.via.array.size);
+            args_type args_real;
+            args.convert(args_real);
+            ftl::internal::call(func, args_real);
+            return msgpack::object();
+        });
     }
 
     /**
@@ -143,13 +141,10 @@ class Dispatcher {
 
         enforce_unique_name(name);
         UNIQUE_LOCK(mutex_, lk);
-        funcs_.insert(std::make_pair(name, [func,
-                                            name](ftl::net::PeerBase &p, msgpack::object const &args) {
+        _insert(name, [func, name](ftl::net::PeerBase &p, msgpack::object const &args, msgpack::zone &z) {
             enforce_arg_count(name, 0, args.via.array.size);
-            auto z = std::make_unique<msgpack::zone>();
-            auto result = msgpack::object(func(), *z);
-            return std::make_unique<msgpack::object_handle>(result, std::move(z));
-        }));
+            return msgpack::object(func(), z);
+        });
     }
 
     /**
@@ -167,16 +162,13 @@ class Dispatcher {
 
         enforce_unique_name(name);
         UNIQUE_LOCK(mutex_, lk);
-        funcs_.insert(std::make_pair(name, [func,
-                                            name](ftl::net::PeerBase &p, msgpack::object const &args) {
+        _insert(name, [func, name](ftl::net::PeerBase &p, msgpack::object const &args, msgpack::zone &z) {
             constexpr int args_count = std::tuple_size<args_type>::value;
             enforce_arg_count(name, args_count, args.via.array.size);
             args_type args_real;
             args.convert(args_real);
-            auto z = std::make_unique<msgpack::zone>();
-            auto result = msgpack::object(ftl::internal::call(func, args_real), *z);
-            return std::make_unique<msgpack::object_handle>(result, std::move(z));
-        }));
+            return msgpack::object(ftl::internal::call(func, args_real), z);
+        });
     }
 
     // With peer object ========================================================
@@ -188,12 +180,11 @@ class Dispatcher {
                           ftl::internal::true_ const &) {
         enforce_unique_name(name);
         UNIQUE_LOCK(mutex_, lk);
-        funcs_.insert(
-            std::make_pair(name, [func, name](ftl::net::PeerBase &p, msgpack::object const &args) {
-                enforce_arg_count(name, 0, args.via.array.size);
-                func(p);
-                return std::make_unique<msgpack::object_handle>();
-            }));
+        _insert(name, [func, name](ftl::net::PeerBase &p, msgpack::object const &args, msgpack::zone &z) {
+            enforce_arg_count(name, 0, args.via.array.size);
+            func(p);
+            return msgpack::object();
+        });
     }
 
     template <typename F>
@@ -206,15 +197,14 @@ class Dispatcher {
 
         enforce_unique_name(name);
         UNIQUE_LOCK(mutex_, lk);
-        funcs_.insert(
-            std::make_pair(name, [func, name](ftl::net::PeerBase &p, msgpack::object const &args) {
-                constexpr int args_count = std::tuple_size<args_type>::value;
-                enforce_arg_count(name, args_count, args.via.array.size);
-                args_type args_real;
-                args.convert(args_real);
-                ftl::internal::call(func, p, args_real);
-                return std::make_unique<msgpack::object_handle>();
-            }));
+        _insert(name, [func, name](ftl::net::PeerBase &p, msgpack::object const &args, msgpack::zone &z) {
+            constexpr int args_count = std::tuple_size<args_type>::value;
+            enforce_arg_count(name, args_count, args.via.array.size);
+            args_type args_real;
+            args.convert(args_real);
+            ftl::internal::call(func, p, args_real);
+            return msgpack::object();
+        });
     }
 
     template <typename F>
@@ -226,13 +216,10 @@ class Dispatcher {
 
         enforce_unique_name(name);
         UNIQUE_LOCK(mutex_, lk);
-        funcs_.insert(std::make_pair(name, [func,
-                                            name](ftl::net::PeerBase &p, msgpack::object const &args) {
+        _insert(name, [func, name](ftl::net::PeerBase &p, msgpack::object const &args, msgpack::zone &z) {
             enforce_arg_count(name, 0, args.via.array.size);
-            auto z = std::make_unique<msgpack::zone>();
-            auto result = msgpack::object(func(p), *z);
-            return std::make_unique<msgpack::object_handle>(result, std::move(z));
-        }));
+            return msgpack::object(func(p), z);
+        });
     }
 
     template <typename F>
@@ -245,16 +232,13 @@ class Dispatcher {
 
         enforce_unique_name(name);
         UNIQUE_LOCK(mutex_, lk);
-        funcs_.insert(std::make_pair(name, [func,
-                                            name](ftl::net::PeerBase &p, msgpack::object const &args) {
+        _insert(name, [func, name](ftl::net::PeerBase &p, msgpack::object const &args, msgpack::zone &z) {
             constexpr int args_count = std::tuple_size<args_type>::value;
             enforce_arg_count(name, args_count, args.via.array.size);
             args_type args_real;
             args.convert(args_real);
-            auto z = std::make_unique<msgpack::zone>();
-            auto result = msgpack::object(ftl::internal::call(func, p, args_real), *z);
-            return std::make_unique<msgpack::object_handle>(result, std::move(z));
-        }));
+            return msgpack::object(ftl::internal::call(func, p, args_real), z);
+        });
     }
 
     //==========================================================================
@@ -278,11 +262,16 @@ class Dispatcher {
 
     //==== Types ===============================================================
 
-    using adaptor_type = std::function<std::unique_ptr<msgpack::object_handle>(
-        ftl::net::PeerBase &, msgpack::object const &)>;
+    /**
+     * Decodes arguments and calls the bound function. Any result is created
+     * in the given zone, which the dispatcher reuses once it has been sent.
+     */
+    using adaptor_type = std::function<msgpack::object(
+        ftl::net::PeerBase &, msgpack::object const &, msgpack::zone &)>;
 
     //! \brief This is the type of messages as per the msgpack-rpc spec.
-    using call_t = std::tuple<int8_t, uint32_t, std::string, msgpack::object>;
+    //! The method name is left as an object, it is only copied for lookup.
+    using call_t = std::tuple<int8_t, uint32_t, msgpack::object, msgpack::object>;
 
     //! \brief This is the type of notification messages.
     using notification_t = std::tuple<int8_t, std::string, msgpack::object>;
@@ -290,12 +279,28 @@ class Dispatcher {
     using response_t =
         std::tuple<uint32_t, uint32_t, msgpack::object, msgpack::object>;
 
+    /** Set in method ids of handlers bound in the parent dispatcher. */
+    static constexpr uint32_t kParentId = 1u << 31;
+
+    /**
+     * Numeric id for a bound name, valid for the lifetime of this dispatcher
+     * (kept if unbound and bound again). Names bound in the parent have
+     * kParentId set. Used as a compact message name by peers that support it.
+     */
+    std::optional<uint32_t> getMethodId(const std::string &name) const;
+
  private:
     Dispatcher *parent_;
-    std::unordered_map<std::string, adaptor_type> funcs_;
+    std::unordered_map<std::string, uint32_t> ids_;     // Name to index in funcs_
+    std::vector<adaptor_type> funcs_;                   // Empty if unbound
     mutable SHARED_MUTEX mutex_;
 
-    std::optional<adaptor_type> _locateHandler(const std::string &name) const;
+    // mutex_ must be locked (unique)
+    void _insert(const std::string &name, adaptor_type &&func);
+
+    std::optional<uint32_t> _locateId(const std::string &name) const;
+    const adaptor_type *_locateHandler(uint32_t id) const;
+    const adaptor_type *_locateHandler(const std::string &name) const;
 
     static void enforce_arg_count(std::string const &func, std::size_t found,
                                   std::size_t expected);
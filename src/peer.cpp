@@ -9,6 +9,8 @@
 
 #include "rpc/time.hpp"
 
+#include <string_view>
+
 using ftl::net::PeerBase;
 using ftl::protocol::NodeStatus;
 using ftl::protocol::Error;
@@ -31,6 +33,11 @@ PeerBase::PeerBase(const ftl::URI& uri, ftl::net::Universe* net, ftl::net::Dispa
     });
 
     bind("__ping__", ftl::time::get_time);
+
+    bind("__method_id__", [this](const std::string &name, uint32_t id) {
+        UNIQUE_LOCK(ids_mtx_, lk);
+        remote_ids_[name] = id;
+    });
 }
 
 PeerBase::~PeerBase() {
@@ -91,11 +98,36 @@ void PeerBase::_sendErrorResponse(uint32_t id, const msgpack::object &res) {
     }
 }
 
+int PeerBase::send_payload_(const std::string& name, msgpack_buffer_t&& buffer, const uint8_t *payload, size_t size, SendFlags flags) {
+    buffer.write(reinterpret_cast<const char*>(payload), size);
+    return send_buffer_(name, std::move(buffer), flags);
+}
+
+int PeerBase::sendEncoded(SendFlags flags, const std::string &name, const shared_buffer_t &encoded) {
+    auto buffer = get_buffer_();
+    buffer.write(encoded->data(), encoded->size());
+    return send_buffer_(name, std::move(buffer), flags);
+}
+
 void PeerBase::waitForCallbacks() {
 
 }
 
 void PeerBase::process_message_(msgpack::object_handle& object) {
+    // Remote features are in the type of the handshake notification
+    if (status_ == NodeStatus::kConnecting) {
+        const msgpack::object &msg = object.get();
+        if (msg.type == msgpack::type::ARRAY && msg.via.array.size == 3
+                && msg.via.array.ptr[1].type == msgpack::type::STR
+                && std::string_view(msg.via.array.ptr[1].via.str.ptr, msg.via.array.ptr[1].via.str.size) == "__handshake__") {
+            UNIQUE_LOCK(ids_mtx_, lk);
+            remote_ids_.clear();
+            announced_ids_.clear();
+            const auto &type = msg.via.array.ptr[0];
+            remote_features_ = (type.type == msgpack::type::POSITIVE_INTEGER) ? static_cast<int>(type.via.u64) : 0;
+        }
+    }
+
     try {
         disp_->dispatch(*this, *object);
     } catch (const std::exception &e) {
@@ -108,7 +140,38 @@ void PeerBase::send_handshake() {
         << "[BUG] Peer is in an invalid state (" << int(status_.load()) << ") for protocol handshake";
     
     handshake_sent_ = true;
-    send("__handshake__", ftl::net::kMagic, ftl::net::kVersion, ftl::UUIDMSGPACK(net_->id()));
+
+    // As send(), but the message type lists supported features
+    auto buffer = get_buffer_();
+    try {
+        msgpack::pack(buffer, std::make_tuple(
+            ftl::net::kFeatures,
+            std::string("__handshake__"),
+            std::make_tuple(ftl::net::kMagic, ftl::net::kVersion, ftl::UUIDMSGPACK(net_->id()))));
+        send_buffer_("__handshake__", std::move(buffer));
+    } catch (...) {
+        LOG(ERROR) << "Peer::send_handshake failed";
+    }
+}
+
+void PeerBase::_announceMethodId(const std::string &name, uint32_t id) {
+    if ((remote_features_ & ftl::net::kFeatureMethodIds) == 0) return;
+    // Internal messages are rare, keep them readable
+    if (name.rfind("__", 0) == 0) return;
+
+    {
+        UNIQUE_LOCK(ids_mtx_, lk);
+        if (!announced_ids_.insert(id).second) return;
+    }
+    send("__method_id__", name, id);
+}
+
+std::optional<uint32_t> PeerBase::remoteMethodId(const std::string &name) const {
+    if ((remote_features_ & ftl::net::kFeatureMethodIds) == 0) return {};
+    SHARED_LOCK(ids_mtx_, lk);
+    auto it = remote_ids_.find(name);
+    if (it == remote_ids_.end()) return {};
+    return it->second;
 }
 
 int32_t PeerBase::getRtt() const { return clock_info_.getRtt(); }
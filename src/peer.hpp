@@ -19,7 +19,11 @@
 #include <chrono>
 #include <memory>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <optional>
 #include <utility>
+#include <functional>
 #include <string>
 
 #include <msgpack.hpp>
@@ -48,7 +52,7 @@ namespace net {
 enum SendFlags
 {
     NONE = 0,
-    DELAY = 1
+    DELAY = 1       // More will follow soon, may be held back briefly and sent with later messages
 };
 
 
@@ -62,6 +66,7 @@ class PeerBase
 
 public:
     using msgpack_buffer_t = msgpack::sbuffer;
+    using shared_buffer_t = std::shared_ptr<const msgpack_buffer_t>;
 
 public:
     friend class Dispatcher;
@@ -131,6 +136,9 @@ public:
 
     inline int localID() const { return local_id_; }
 
+    /** Universe I/O thread this peer is pinned to, -1 if not assigned. */
+    inline int ioThread() const { return io_thread_; }
+
     /**
      * Get the peer id as a string.
      */
@@ -167,11 +175,60 @@ public:
      * @param name RPC Function name
      * @param args Variable number of arguments for function
      * 
-     * @return status code (TODO: specify)
+     * @return kSendOk if sent or queued, kSendWouldBlock if the outgoing
+     *         queue limit was reached and the message was dropped, negative
+     *         on error.
      */
     template <typename... ARGS>
     int send(const std::string &name, ARGS&&... args);
 
+    /**
+     * As send() above, with flags. SendFlags::DELAY allows the message to be
+     * held back and coalesced with following messages, a message sent
+     * without DELAY flushes everything before it.
+     */
+    template <typename... ARGS>
+    int send(SendFlags flags, const std::string &name, ARGS&&... args);
+
+    /**
+     * As send() with flags, but the message ends with payload bytes which are
+     * written from the given memory instead of being copied into the send
+     * buffer. Packed arguments must end with a msgpack bin header for exactly
+     * size bytes (see PacketHeaderMSGPACK). The payload must stay valid until
+     * the call returns; it is copied only if it can not be written directly.
+     */
+    template <typename... ARGS>
+    int sendWithPayload(SendFlags flags, const uint8_t *payload, size_t size, const std::string &name, ARGS&&... args);
+
+    /**
+     * Serialise a send() message once, to be sent to many peers with
+     * sendEncoded().
+     */
+    template <typename... ARGS>
+    static shared_buffer_t encode(const std::string &name, ARGS&&... args);
+
+    /**
+     * As encode(), but using a method id from remoteMethodId() if given. The
+     * buffer may only be shared by peers that gave the same id.
+     */
+    template <typename... ARGS>
+    static shared_buffer_t encode(const std::optional<uint32_t> &id, const std::string &name, ARGS&&... args);
+
+    /**
+     * Method id the remote has given for a notification name, if it supports
+     * them. Ids are chosen by each remote, so they differ between peers.
+     */
+    std::optional<uint32_t> remoteMethodId(const std::string &name) const;
+
+    /**
+     * Send a message encoded with encode(). The buffer is never modified and
+     * may be shared by several peers, implementations keep a reference
+     * instead of a copy if the message has to be queued.
+     * 
+     * @return As send()
+     */
+    virtual int sendEncoded(SendFlags flags, const std::string &name, const shared_buffer_t &buffer);
+
     // NOTE: not used
     template <typename... ARGS>
     int try_send(const std::string &name, ARGS... args);
@@ -204,6 +261,10 @@ public:
     static const int kMaxMessage = 4*1024*1024;      // 4Mb currently
     static const int kDefaultMessage = 512*1024;     // 0.5Mb currently
 
+    // send() results
+    static constexpr int kSendOk = 1;
+    static constexpr int kSendWouldBlock = 0;
+
     /** send raw buffer directly (useful for pass-through without decoding) 
      *  should have some mechanism to track how many writes are in flight (output atomic int counter)
      */
@@ -227,9 +288,17 @@ protected:
     // send buffer to network (and return the buffer to peer instance)
     virtual int send_buffer_(const std::string& name, msgpack_buffer_t&& buffer, SendFlags flags = SendFlags::NONE) = 0;
 
+    // send buffer followed by payload bytes (not owned). Default appends the
+    // payload to the buffer.
+    virtual int send_payload_(const std::string& name, msgpack_buffer_t&& buffer, const uint8_t *payload, size_t size, SendFlags flags);
+
     // call on received message (sync)
     void process_message_(msgpack::object_handle& object);
 
+    // pack a notification, using the method id if remote has given one
+    template <typename... ARGS>
+    void pack_notification_(msgpack_buffer_t &buffer, const std::string &name, ARGS&&... args);
+
     // process handshke, returns true if valid handshake received
     bool process_handshake_(msgpack::object_handle& object);
     bool process_handshake_(uint64_t magic, uint32_t version, const ftl::UUIDMSGPACK &pid);
@@ -240,6 +309,9 @@ private:
     void _sendResponse(uint32_t id, const msgpack::object &obj);
     void _sendErrorResponse(uint32_t id, const msgpack::object &obj);
 
+    // Tell remote the id of a method it has called by name (once)
+    void _announceMethodId(const std::string &name, uint32_t id);
+
     /*
     void _updateURI();
     void _set_socket_options();
@@ -248,6 +320,7 @@ private:
 
 protected:
     int local_id_ = -1;
+    int io_thread_ = -1;
 
     ftl::URI uri_;                                  // Original connection URI, or assumed URI
     ftl::UUID peerid_;                              // Received in handshake or allocated
@@ -271,6 +344,12 @@ private:
     static std::atomic_int rpcid__;                 // Return ID for RPC calls
 
     bool handshake_sent_ = false;
+
+    // Method ids, reset on handshake
+    std::atomic_int remote_features_ = 0;                       // Features in remote handshake
+    mutable SHARED_MUTEX ids_mtx_;
+    std::unordered_map<std::string, uint32_t> remote_ids_;      // Given by remote, used in send()
+    std::unordered_set<uint32_t> announced_ids_;                // Given to remote
 };
 
 
@@ -278,12 +357,26 @@ private:
 
 template <typename... ARGS>
 int PeerBase::send(const std::string &name, ARGS&&... args) {
-    auto args_obj = std::make_tuple(args...);
-    auto call_obj = std::make_tuple(0, name, args_obj);
+    return send(SendFlags::NONE, name, std::forward<ARGS>(args)...);
+}
+
+template <typename... ARGS>
+void PeerBase::pack_notification_(msgpack_buffer_t &buffer, const std::string &name, ARGS&&... args) {
+    // Arguments are packed by reference, large arguments are not copied
+    auto id = remoteMethodId(name);
+    if (id) {
+        msgpack::pack(buffer, std::make_tuple(0, *id, std::forward_as_tuple(args...)));
+    } else {
+        msgpack::pack(buffer, std::make_tuple(0, std::cref(name), std::forward_as_tuple(args...)));
+    }
+}
+
+template <typename... ARGS>
+int PeerBase::send(SendFlags flags, const std::string &name, ARGS&&... args) {
     auto buffer = get_buffer_();
     try {
-        msgpack::pack(buffer, call_obj);
-        return send_buffer_(name, std::move(buffer));
+        pack_notification_(buffer, name, std::forward<ARGS>(args)...);
+        return send_buffer_(name, std::move(buffer), flags);
 
     } catch (...) {
         LOG(ERROR) << "Peer::send failed";
@@ -291,6 +384,35 @@ int PeerBase::send(const std::string &name, ARGS&&... args) {
     return -1;
 }
 
+template <typename... ARGS>
+int PeerBase::sendWithPayload(SendFlags flags, const uint8_t *payload, size_t size, const std::string &name, ARGS&&... args) {
+    auto buffer = get_buffer_();
+    try {
+        pack_notification_(buffer, name, std::forward<ARGS>(args)...);
+        return send_payload_(name, std::move(buffer), payload, size, flags);
+
+    } catch (...) {
+        LOG(ERROR) << "Peer::sendWithPayload failed";
+    }
+    return -1;
+}
+
+template <typename... ARGS>
+PeerBase::shared_buffer_t PeerBase::encode(const std::string &name, ARGS&&... args) {
+    auto call_obj = std::make_tuple(0, std::cref(name), std::forward_as_tuple(args...));
+    auto buffer = std::make_shared<msgpack_buffer_t>();
+    msgpack::pack(*buffer, call_obj);
+    return buffer;
+}
+
+template <typename... ARGS>
+PeerBase::shared_buffer_t PeerBase::encode(const std::optional<uint32_t> &id, const std::string &name, ARGS&&... args) {
+    if (!id) return encode(name, std::forward<ARGS>(args)...);
+    auto buffer = std::make_shared<msgpack_buffer_t>();
+    msgpack::pack(*buffer, std::make_tuple(0, *id, std::forward_as_tuple(args...)));
+    return buffer;
+}
+
 template <typename F>
 void PeerBase::bind(const std::string &name, F func) {
     // TODO: debug log all bindings (local and remote)
@@ -12,9 +12,9 @@
 #include <vector>
 #include <utility>
 #include <string>
+#include <array>
 
 #include <ftl/lib/loguru.hpp>
-#include <ftl/lib/ctpl_stl.hpp>
 #include <ftl/counter.hpp>
 #include <ftl/profiler.hpp>
 
@@ -206,6 +206,15 @@ void PeerTcp::close(bool retry) {
 void PeerTcp::_close(bool retry) {
     if (status_ != NodeStatus::kConnected && status_ != NodeStatus::kConnecting) return;
 
+    {
+        UNIQUE_LOCK(send_mtx_, lk);
+        send_queue_.clear();
+        pending_bytes_ = 0;
+        pending_sends_ = 0;
+        write_interest_ = false;
+        flush_scheduled_ = false;
+    }
+
     // Attempt auto reconnect?
     if (retry && can_reconnect_) {
         status_ = NodeStatus::kReconnecting;
@@ -256,41 +265,126 @@ void PeerTcp::set_buffer_(PeerBase::msgpack_buffer_t&& buffer) {
 }
 
 int PeerTcp::send_buffer_(const std::string& name, msgpack_buffer_t&& send_buffer, SendFlags flags) {
-    if (!sock_->is_valid()) return -1;
+    return _send(name, std::move(send_buffer), nullptr, 0, flags);
+}
+
+int PeerTcp::send_payload_(const std::string& name, msgpack_buffer_t&& send_buffer, const uint8_t *payload, size_t size, SendFlags flags) {
+    return _send(name, std::move(send_buffer), payload, size, flags);
+}
+
+int PeerTcp::_send(const std::string& name, msgpack_buffer_t&& send_buffer, const uint8_t *payload, size_t size, SendFlags flags) {
+    // send_mtx_ is locked by get_buffer_() and released by set_buffer_()
+    if (!sock_->is_valid()) {
+        set_buffer_(std::move(send_buffer));
+        return -1;
+    }
+
+    // Earlier messages still waiting (socket or delay), or this may wait:
+    // queue to keep order and to write all of them with one call.
+    const bool delay = flags & SendFlags::DELAY;
+    if (!send_queue_.empty() || delay) {
+        if (pending_bytes_ + send_buffer.size() + size > max_pending_bytes_) {
+            DLOG(WARNING) << "Send queue full (" << (pending_bytes_ >> 10) << " KiB), dropping " << name;
+            set_buffer_(std::move(send_buffer));
+            return kSendWouldBlock;
+        }
+
+        // Payload memory is not ours to keep
+        if (size > 0) send_buffer.write(reinterpret_cast<const char*>(payload), size);
+        _queueBuffer(std::move(send_buffer), 0);
+        _sendQueued(delay);
+
+        set_buffer_(msgpack_buffer_t());
+        return kSendOk;
+    }
+
+    // WebSocket masks in place, payload must not be modified
+    if (size > 0 && sock_->modifies_buffers()) {
+        send_buffer.write(reinterpret_cast<const char*>(payload), size);
+        payload = nullptr;
+        size = 0;
+    }
 
     ssize_t c = 0;
 
     try {
         // In trivial tests (serializing large buffers) sbuffer turned out to be about 12% faster as well
-        iovec vec = { send_buffer.data(), send_buffer.size() };
-        const iovec* vec_ptr = &vec; 
-        //      send_buf_.vector();
-        size_t vec_size = 1; 
-        //      send_buf_.vector_size();
-
-        c = sock_->writev(vec_ptr, vec_size);
-        if (c <= 0) {
+        iovec vec[2] = {
+            { send_buffer.data(), send_buffer.size() },
+            { const_cast<uint8_t*>(payload), size }
+        };
+
+        c = sock_->try_writev(vec, (size > 0) ? 2 : 1);
+        if (c < 0) {
             // writev() should probably throw exception which is reported here
             // at the moment, error message is (should be) printed by writev()
             net_->notifyError_(this, ftl::protocol::Error::kSocketError, "writev() failed");
+            _close(reconnect_on_socket_error_);
             set_buffer_(std::move(send_buffer));
             return c;
         }
 
-        ssize_t sz = 0; for (size_t i = 0; i < vec_size; i++) {
-            sz += vec_ptr[i].iov_len;
-        }
-        if (c != sz) {
-            net_->notifyError_(this, ftl::protocol::Error::kSocketError, "writev(): incomplete send");
-            _close(reconnect_on_socket_error_);
+        net_->txBytes_ += c;
+        #ifdef TRACY_ENABLE
+        TracyPlot("tx", double(c));
+        #endif
+
+        if (static_cast<size_t>(c) == send_buffer.size() + size) {
+            // Framed transports may still hold the end of the frame
+            if (sock_->has_pending_writes()) _updateWriteInterest(true);
+            set_buffer_(std::move(send_buffer));
+        } else {
+            // Socket buffer full, remainder is written by Universe thread.
+            // Payload is copied here as it must outlive this call.
+            if (size > 0) send_buffer.write(reinterpret_cast<const char*>(payload), size);
+            _queueBuffer(std::move(send_buffer), c);
+            _updateWriteInterest(true);
+            set_buffer_(msgpack_buffer_t());
         }
 
+    } catch (std::exception& ex) {
+        net_->notifyError_(this, ftl::protocol::Error::kSocketError, ex.what());
+        _close(reconnect_on_socket_error_);
         set_buffer_(std::move(send_buffer));
+        return -1;
+    }
+
+    return kSendOk;
+}
+
+int PeerTcp::sendEncoded(SendFlags flags, const std::string &name, const shared_buffer_t &buffer) {
+    UNIQUE_LOCK(send_mtx_, lk);
+    if (!sock_->is_valid()) return -1;
+
+    // WebSocket masks in place, must not touch the shared buffer
+    if (sock_->modifies_buffers()) return PeerBase::sendEncoded(flags, name, buffer);
 
+    const bool delay = flags & SendFlags::DELAY;
+    if (!send_queue_.empty() || delay) {
+        if (pending_bytes_ + buffer->size() > max_pending_bytes_) {
+            DLOG(WARNING) << "Send queue full (" << (pending_bytes_ >> 10) << " KiB), dropping " << name;
+            return kSendWouldBlock;
+        }
+
+        _queueBuffer(buffer, 0);
+        _sendQueued(delay);
+        return kSendOk;
+    }
+
+    ssize_t c = 0;
+    try {
+        iovec vec = { const_cast<char*>(buffer->data()), buffer->size() };
+        c = sock_->try_writev(&vec, 1);
     } catch (std::exception& ex) {
         net_->notifyError_(this, ftl::protocol::Error::kSocketError, ex.what());
         _close(reconnect_on_socket_error_);
-        set_buffer_(std::move(send_buffer));
+        return -1;
+    }
+
+    if (c < 0) {
+        net_->notifyError_(this, ftl::protocol::Error::kSocketError, "writev() failed");
+        _close(reconnect_on_socket_error_);
+        return c;
     }
 
     net_->txBytes_ += c;
@@ -298,8 +392,111 @@ int PeerTcp::send_buffer_(const std::string& name, msgpack_buffer_t&& send_buffe
     TracyPlot("tx", double(c));
     #endif
 
-    // API change, return send id (synchronous socket, nothing to cancel)
-    return 1;
+    if (static_cast<size_t>(c) < buffer->size()) {
+        // Keep a reference to the remainder, written by Universe thread
+        _queueBuffer(buffer, c);
+        _updateWriteInterest(true);
+    } else if (sock_->has_pending_writes()) {
+        _updateWriteInterest(true);
+    }
+    return kSendOk;
+}
+
+void PeerTcp::_queueBuffer(msgpack_buffer_t &&buffer, size_t offset) {
+    pending_bytes_ += buffer.size() - offset;
+    ++pending_sends_;
+    send_queue_.push_back({std::move(buffer), nullptr, offset});
+}
+
+void PeerTcp::_queueBuffer(const shared_buffer_t &buffer, size_t offset) {
+    pending_bytes_ += buffer->size() - offset;
+    ++pending_sends_;
+    send_queue_.push_back({msgpack_buffer_t(0), buffer, offset});
+}
+
+void PeerTcp::_sendQueued(bool delay) {
+    if (delay && pending_bytes_ < kMaxCoalesceBytes) {
+        // Universe calls flush() when coalescing window has passed
+        if (!flush_scheduled_) flush_scheduled_ = net_->_scheduleFlush(this);
+        if (!flush_scheduled_) _flushSendQueue();
+    } else {
+        _flushSendQueue();
+    }
+}
+
+void PeerTcp::_updateWriteInterest(bool enable) {
+    if (write_interest_ == enable) return;
+    write_interest_ = enable;
+    net_->_setWriteInterest(this, enable);
+}
+
+void PeerTcp::flush() {
+    UNIQUE_LOCK(send_mtx_, lk);
+    flush_scheduled_ = false;
+    _flushSendQueue();
+}
+
+bool PeerTcp::_flushSendQueue() {
+    UNIQUE_LOCK(send_mtx_, lk);
+    if (!sock_->is_valid()) return send_queue_.empty();
+
+    // Rest of a TLS record or WebSocket frame goes first
+    if (!sock_->flush_pending()) {
+        net_->notifyError_(this, ftl::protocol::Error::kSocketError, "writev() failed");
+        _close(reconnect_on_socket_error_);
+        return false;
+    }
+
+    if (send_queue_.empty()) {
+        _updateWriteInterest(sock_->has_pending_writes());
+        return true;
+    }
+
+    static constexpr size_t kMaxVecs = 64;
+    std::array<iovec, kMaxVecs> vecs;
+    std::array<int, kMaxVecs> counts;
+    size_t count = 0;
+    for (auto &item : send_queue_) {
+        if (count == kMaxVecs) break;
+        vecs[count] = { const_cast<char*>(item.data()) + item.offset, item.size() - item.offset };
+        counts[count++] = 1;
+    }
+
+    ssize_t c = 0;
+    try {
+        c = sock_->try_writev_messages(vecs.data(), counts.data(), static_cast<int>(count));
+    } catch (std::exception& ex) {
+        net_->notifyError_(this, ftl::protocol::Error::kSocketError, ex.what());
+        c = -1;
+    }
+
+    if (c < 0) {
+        net_->notifyError_(this, ftl::protocol::Error::kSocketError, "writev() failed");
+        _close(reconnect_on_socket_error_);
+        return false;
+    }
+
+    net_->txBytes_ += c;
+    #ifdef TRACY_ENABLE
+    TracyPlot("tx", double(c));
+    #endif
+
+    pending_bytes_ -= c;
+    size_t remaining = c;
+    while (remaining > 0) {
+        auto &item = send_queue_.front();
+        const size_t size = item.size() - item.offset;
+        if (remaining < size) {
+            item.offset += remaining;
+            break;
+        }
+        remaining -= size;
+        send_queue_.pop_front();
+        --pending_sends_;
+    }
+
+    _updateWriteInterest(!send_queue_.empty() || sock_->has_pending_writes());
+    return send_queue_.empty();
 }
 
 ///
@@ -369,7 +566,7 @@ void PeerTcp::recv() {
 }
 
 void PeerTcp::_createJob() {
-    ftl::pool.push([this, c = std::move(ftl::Counter(&job_count_))](int id) {
+    ftl::pool.post([this, c = std::move(ftl::Counter(&job_count_))](int id) {
         try {
             while (_data());
         } catch (const std::exception &e) {
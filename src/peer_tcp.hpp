@@ -1,4 +1,5 @@
 #pragma once
+#include <deque>
 #include "peer.hpp"
 
 #include "common_fwd.hpp"
@@ -103,9 +104,30 @@ class PeerTcp : public PeerBase {
 
     void shutdown() override;
 
+    // Queued messages and bytes not yet written to the socket
+    int pendingWriteCals() override { return pending_sends_; }
+    int pendingOutgoing() override { return static_cast<int>(pending_bytes_); }
+
+    /**
+     * Limit for bytes waiting in the outgoing queue. Once reached, send()
+     * drops the message and returns kSendWouldBlock instead of blocking.
+     */
+    void setMaxPendingBytes(size_t bytes) { max_pending_bytes_ = bytes; }
+    size_t getMaxPendingBytes() const { return max_pending_bytes_; }
+
+    /**
+     * Write any messages held back by SendFlags::DELAY now. Called by
+     * Universe once the coalescing window has passed.
+     */
+    void flush();
+
+    int sendEncoded(SendFlags flags, const std::string &name, const shared_buffer_t &buffer) override;
+
 public:
     static const int kMaxMessage = 4*1024*1024;      // 4Mb currently
     static const int kDefaultMessage = 512*1024;     // 0.5Mb currently
+    static const size_t kDefaultMaxPendingBytes = 24*1024*1024;
+    static const size_t kMaxCoalesceBytes = 64*1024;  // Flush delayed messages beyond this
 
 protected:
     msgpack_buffer_t get_buffer_() override;
@@ -113,10 +135,17 @@ protected:
     // send buffer to network
     int send_buffer_(const std::string&, msgpack_buffer_t&&, SendFlags) override;
 
+    // send buffer and payload with one vectored write, payload is copied
+    // only if it has to be queued
+    int send_payload_(const std::string&, msgpack_buffer_t&&, const uint8_t*, size_t, SendFlags) override;
+
 private:  // Functions
     // opposite of get_buffer
     void set_buffer_(msgpack_buffer_t&&);
 
+    // common implementation of send_buffer_() and send_payload_()
+    int _send(const std::string&, msgpack_buffer_t&&, const uint8_t *payload, size_t size, SendFlags);
+
     bool socketError();  // Process one error from socket
     void error(int e);
 
@@ -147,6 +176,22 @@ private:  // Functions
 
     void _createJob();
 
+    // Queue (remaining part of) a buffer for writing later. send_mtx_ must
+    // be locked.
+    void _queueBuffer(msgpack_buffer_t &&buffer, size_t offset);
+    void _queueBuffer(const shared_buffer_t &buffer, size_t offset);
+
+    // Write now or schedule a flush after queueing, send_mtx_ must be locked
+    void _sendQueued(bool delay);
+
+    // Write as much of the send queue as possible without blocking, in one
+    // call. Called by Universe when the socket is writable. Returns true if
+    // queue is empty.
+    bool _flushSendQueue();
+
+    // Update writable notifications from Universe, send_mtx_ must be locked.
+    void _updateWriteInterest(bool enable);
+
     void _waitCall(int id, std::condition_variable &cv, bool &hasreturned, const std::string &name);
 
     std::atomic_flag already_processing_ = ATOMIC_FLAG_INIT;
@@ -160,6 +205,22 @@ private:  // Functions
     msgpack::sbuffer send_buf_;
     DECLARE_RECURSIVE_MUTEX(send_mtx_);
 
+    // Outgoing queue, protected by send_mtx_
+    struct SendItem {
+        msgpack_buffer_t buffer;
+        shared_buffer_t shared;                     // Used instead of buffer if set
+        size_t offset;                              // Bytes already written
+
+        const char *data() const { return shared ? shared->data() : buffer.data(); }
+        size_t size() const { return shared ? shared->size() : buffer.size(); }
+    };
+    std::deque<SendItem> send_queue_;
+    std::atomic_size_t pending_bytes_ = 0;
+    std::atomic_int pending_sends_ = 0;
+    size_t max_pending_bytes_ = kDefaultMaxPendingBytes;
+    std::atomic_bool write_interest_ = false;       // Universe notifies when writable
+    bool flush_scheduled_ = false;                  // Delayed messages, Universe will call flush()
+
     const bool outgoing_;
 
     uint32_t version_;                              // Received protocol version in handshake
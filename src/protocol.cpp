@@ -17,8 +17,8 @@
 static std::shared_ptr<ftl::net::Universe> universe;
 static std::mutex globalmtx;
 
-// ctpl::thread_pool ftl::pool(std::thread::hardware_concurrency()*2);
-ctpl::thread_pool ftl::pool(4);
+// ftl::ThreadPool ftl::pool(std::thread::hardware_concurrency()*2);
+ftl::ThreadPool ftl::pool(4);
 
 void ftl::set_thread_name(const std::string& name) {
     #if TRACY_ENABLE
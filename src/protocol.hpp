@@ -22,5 +22,13 @@ static const uint64_t kMagic = 0x0009340053640912;
 static const uint32_t kVersion = (FTL_VERSION_MAJOR << 16) +
         (FTL_VERSION_MINOR << 8) + FTL_VERSION_PATCH;
 
+/**
+ * Optional protocol features, sent as the message type of the handshake
+ * notification. Older peers ignore the type of notifications and always send
+ * zero, so nothing is enabled for them.
+ */
+static const int8_t kFeatureMethodIds = 0x10;  // Notifications may use numeric method ids
+static const int8_t kFeatures = kFeatureMethodIds;
+
 }  // namespace net
 }  // namespace ftl
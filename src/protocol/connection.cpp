@@ -71,6 +71,8 @@ ssize_t SocketConnection::send(const char* buffer, size_t len) {
 }
 
 ssize_t SocketConnection::writev(const struct iovec *iov, int iovcnt) {
+    if (!drain_pending_()) return -1;
+
     ssize_t sent = sock_.writev(iov, iovcnt);
 
     ssize_t requested = 0;
@@ -149,6 +151,80 @@ ssize_t SocketConnection::writev(const struct iovec *iov, int iovcnt) {
     return requested;
 }
 
+ssize_t SocketConnection::try_writev_messages(const struct iovec *iov, const int *counts, int msgcnt) {
+    // Stream transport, message boundaries are not needed
+    int iovcnt = 0;
+    for (int i = 0; i < msgcnt; i++) { iovcnt += counts[i]; }
+    return try_writev(iov, iovcnt);
+}
+
+ssize_t SocketConnection::try_writev_whole_(const struct iovec *iov, int iovcnt) {
+    if (!flush_pending()) return -1;
+    if (has_pending_writes()) return 0;
+    return write_or_keep_(iov, iovcnt);
+}
+
+ssize_t SocketConnection::write_or_keep_(const struct iovec *iov, int iovcnt) {
+    size_t requested = 0;
+    for (int i = 0; i < iovcnt; i++) { requested += iov[i].iov_len; }
+
+    // Order must be kept, nothing is written while earlier data waits
+    ssize_t sent = 0;
+    if (!has_pending_writes()) {
+        sent = sock_.try_writev(iov, iovcnt);
+        if (sent < 0) {
+            if (sock_.is_fatal()) {
+                DLOG(ERROR) << "writev(): " << sock_.get_error_string();
+                return sent;
+            }
+            sent = 0;
+        }
+        if (static_cast<size_t>(sent) == requested) return sent;
+        pending_.clear();
+        pending_offset_ = 0;
+    }
+
+    size_t skip = sent;
+    for (int i = 0; i < iovcnt; i++) {
+        const char *base = static_cast<const char*>(iov[i].iov_base);
+        const size_t len = iov[i].iov_len;
+        if (skip >= len) {
+            skip -= len;
+            continue;
+        }
+        pending_.insert(pending_.end(), base + skip, base + len);
+        skip = 0;
+    }
+    return requested;
+}
+
+bool SocketConnection::flush_pending() {
+    while (has_pending_writes()) {
+        struct iovec vec = { pending_.data() + pending_offset_, pending_.size() - pending_offset_ };
+        ssize_t sent = sock_.try_writev(&vec, 1);
+        if (sent < 0) {
+            if (!sock_.is_fatal()) return true;  // Socket buffer full
+            DLOG(ERROR) << "writev(): " << sock_.get_error_string();
+            return false;
+        }
+        if (sent == 0) return true;
+        pending_offset_ += sent;
+    }
+    pending_.clear();
+    pending_offset_ = 0;
+    return true;
+}
+
+bool SocketConnection::drain_pending_() {
+    if (!has_pending_writes()) return true;
+
+    std::vector<char> data;
+    data.swap(pending_);
+    struct iovec vec = { data.data() + pending_offset_, data.size() - pending_offset_ };
+    pending_offset_ = 0;
+    return SocketConnection::writev(&vec, 1) >= 0;
+}
+
 bool SocketConnection::close() {
     return sock_.close();
 }
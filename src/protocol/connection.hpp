@@ -8,6 +8,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 #include <ftl/exception.hpp>
 #include <ftl/uri.hpp>
 #include "../socketImpl.hpp"
@@ -32,9 +33,27 @@ class SocketConnection {
 
     SocketConnection() {}
 
+    // write all of iov or nothing without blocking. Framed transports use
+    // this so that a record/frame is never split between calls: whatever
+    // the socket does not take now is kept and written by flush_pending()
+    // before anything else. Returns size of iov, 0 if earlier data is still
+    // waiting (nothing written), negative on error.
+    virtual ssize_t try_writev_whole_(const struct iovec *iov, int iovcnt);
+
+    // write without blocking (unless data is already waiting) and keep the
+    // rest. Returns size of iov or negative on error.
+    ssize_t write_or_keep_(const struct iovec *iov, int iovcnt);
+
+    // blocking write of any kept data, returns false on error
+    bool drain_pending_();
+
  private:
     bool can_increase_sock_buffer_;
 
+    // data accepted by try_writev_whole_() the socket did not take yet
+    std::vector<char> pending_;
+    size_t pending_offset_ = 0;
+
  public:
     SocketConnection(const SocketConnection&) = delete;
 
@@ -72,6 +91,24 @@ class SocketConnection {
     virtual ssize_t recv(char *buffer, size_t len);
     // scatter write, return number of bytes sent. always sends all data in iov.
     virtual ssize_t writev(const struct iovec *iov, int iovcnt);
+    // scatter write without blocking, returns number of bytes sent which may
+    // be less than requested (0 if socket buffer is full), negative on error.
+    // Default implementation uses writev() and always sends all data.
+    virtual ssize_t try_writev(const struct iovec *iov, int iovcnt) { return writev(iov, iovcnt); }
+    // write several messages with one call, message i consists of counts[i]
+    // iovecs. Message based transports (WebSocket) frame each message
+    // separately. Same return value as try_writev().
+    virtual ssize_t try_writev_messages(const struct iovec *iov, const int *counts, int msgcnt);
+    // true if writes modify the given buffers (in place framing/masking),
+    // callers must then not pass memory they do not own.
+    virtual bool modifies_buffers() const { return false; }
+
+    // true if a framed write is still partly waiting for the socket, caller
+    // should call flush_pending() when socket becomes writable.
+    bool has_pending_writes() const { return pending_offset_ < pending_.size(); }
+    // write as much of the waiting data as possible without blocking,
+    // returns false on error.
+    bool flush_pending();
 
     virtual bool set_recv_buffer_size(size_t sz);
     virtual bool set_send_buffer_size(size_t sz);
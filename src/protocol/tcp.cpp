@@ -49,6 +49,15 @@ void Connection_TCP::connect(const ftl::URI& uri, int timeout) {
     }
 }
 
+ssize_t Connection_TCP::try_writev(const struct iovec *iov, int iovcnt) {
+    auto sent = sock_.try_writev(iov, iovcnt);
+    if (sent < 0) {
+        if (!sock_.is_fatal()) return 0;  // Socket buffer full
+        DLOG(ERROR) << "writev(): " << sock_.get_error_string();
+    }
+    return sent;
+}
+
 // Server_TCP //////////////////////////////////////////////////////////////////
 
 Server_TCP::Server_TCP(const std::string &hostname, int port) :
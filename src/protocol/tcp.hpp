@@ -47,6 +47,8 @@ class Connection_TCP : public SocketConnection {
     ftl::URI::scheme_t scheme() const override { return ftl::URI::SCHEME_TCP; }
     bool connect(const std::string &hostname, int port, int timeout = 0);
     void connect(const ftl::URI& uri, int timeout = 0) override;
+
+    ssize_t try_writev(const struct iovec *iov, int iovcnt) override;
 };
 
 }  // namespace internal
@@ -9,6 +9,7 @@
 #ifdef HAVE_GNUTLS
 
 #include <sstream>
+#include <cerrno>
 #include <iomanip>
 #include <string>
 
@@ -119,6 +120,12 @@ bool Connection_TLS::connect(const std::string& hostname, int port, int timeout)
 
     check_gnutls_error_(gnutls_handshake(session_));
 
+    // Records the socket can not take are kept by the connection, this
+    // allows try_writev() without blocking.
+    gnutls_transport_set_ptr2(
+        session_, reinterpret_cast<gnutls_transport_ptr_t>(static_cast<intptr_t>(sock_.fd())), this);
+    gnutls_transport_set_push_function(session_, &Connection_TLS::push_);
+
     DLOG(INFO) << "TLS connection established: "
               << gnutls_session_get_desc(session_) << "; "
               << get_cert_info(session_);
@@ -160,21 +167,46 @@ ssize_t Connection_TLS::recv(char *buffer, size_t len) {
 }
 
 ssize_t Connection_TLS::send(const char* buffer, size_t len) {
-    return check_gnutls_error_(gnutls_record_send(session_, buffer, len));
+    auto sent = check_gnutls_error_(gnutls_record_send(session_, buffer, len));
+    return (drain_pending_()) ? sent : -1;
 }
 
-ssize_t Connection_TLS::writev(const struct iovec *iov, int iovcnt) {
+ssize_t Connection_TLS::push_(gnutls_transport_ptr_t ptr, const void *data, size_t len) {
+    auto *self = static_cast<Connection_TLS*>(ptr);
+    struct iovec vec = { const_cast<void*>(data), len };
+    auto sent = self->write_or_keep_(&vec, 1);
+    if (sent < 0) gnutls_transport_set_errno(self->session_, EIO);
+    return sent;
+}
+
+ssize_t Connection_TLS::send_records_(const struct iovec *iov, int iovcnt) {
     gnutls_record_cork(session_);
 
+    ssize_t total = 0;
     for (int i = 0; i < iovcnt; i++) {
+        const char *data = static_cast<const char*>(iov[i].iov_base);
         size_t sent = 0;
-        do {
-            // should always succeed and cache whole buffer (no error checking)
-            sent += send((const char*) iov[i].iov_base, iov[i].iov_len);
-        } while (sent < iov[i].iov_len);
+        while (sent < iov[i].iov_len) {
+            // cached while corked
+            sent += check_gnutls_error_(gnutls_record_send(session_, data + sent, iov[i].iov_len - sent));
+        }
+        total += sent;
     }
 
-    return check_gnutls_error_(gnutls_record_uncork(session_, GNUTLS_RECORD_WAIT));
+    check_gnutls_error_(gnutls_record_uncork(session_, GNUTLS_RECORD_WAIT));
+    return total;
+}
+
+ssize_t Connection_TLS::writev(const struct iovec *iov, int iovcnt) {
+    if (!drain_pending_()) return -1;
+    auto sent = send_records_(iov, iovcnt);
+    return (drain_pending_()) ? sent : -1;
+}
+
+ssize_t Connection_TLS::try_writev_whole_(const struct iovec *iov, int iovcnt) {
+    if (!flush_pending()) return -1;
+    if (has_pending_writes()) return 0;
+    return send_records_(iov, iovcnt);
 }
 
 #endif
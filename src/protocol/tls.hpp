@@ -39,12 +39,21 @@ class Connection_TLS : public Connection_TCP {
     ssize_t recv(char *buffer, size_t len) override;
     ssize_t send(const char* buffer, size_t len) override;
     ssize_t writev(const struct iovec *iov, int iovcnt) override;
+    // Whole records are accepted or none, see try_writev_whole_()
+    ssize_t try_writev(const struct iovec *iov, int iovcnt) override { return try_writev_whole_(iov, iovcnt); }
+    ssize_t try_writev_whole_(const struct iovec *iov, int iovcnt) override;
 
     int check_gnutls_error_(int errcode);  // check for fatal error and throw
 
  private:
     gnutls_session_t session_;
     gnutls_certificate_credentials_t xcred_;
+
+    // encrypt iov to records, written (or kept) by push_()
+    ssize_t send_records_(const struct iovec *iov, int iovcnt);
+
+    // gnutls transport push function, never blocks once handshake is done
+    static ssize_t push_(gnutls_transport_ptr_t ptr, const void *data, size_t len);
 };
 
 
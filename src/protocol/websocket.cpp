@@ -315,21 +315,16 @@ bool WebSocketBase<SocketT>::prepare_next(char* data, size_t data_len, size_t& o
 }
 
 template<typename SocketT>
-ssize_t WebSocketBase<SocketT>::writev(const struct iovec *iov, int iovcnt) {
-
-    if ((iovcnt + 1) >= ssize_t(iovecs_.size())) { iovecs_.resize(iovcnt + 1); }
-    // copy iovecs to local buffer, first iovec entry reserved for header
-    std::copy(iov, iov + iovcnt, iovecs_.data() + 1);
-
+int WebSocketBase<SocketT>::frame_(struct iovec *iov, int iovcnt, char *header, size_t header_size) {
     // masking
     size_t msglen = 0;
     uint32_t mask = secure_rnd();
     uint8_t* masking_key = reinterpret_cast<uint8_t*>(&mask);
 
     // calculate total size of message and mask it.
-    for (int i = 1; i < iovcnt + 1; i++) {
-        const size_t mlen = iovecs_[i].iov_len;
-        char *buf = reinterpret_cast<char*>(iovecs_[i].iov_base);
+    for (int i = 0; i < iovcnt; i++) {
+        const size_t mlen = iov[i].iov_len;
+        char *buf = reinterpret_cast<char*>(iov[i].iov_base);
 
         // TODO(Seb): Make this more efficient.
         for (size_t j = 0; j != mlen; ++j) {
@@ -338,11 +333,21 @@ ssize_t WebSocketBase<SocketT>::writev(const struct iovec *iov, int iovcnt) {
         msglen += mlen;
     }
 
+    return ws_prepare(wsheader_type::BINARY_FRAME, true, mask, msglen, header, header_size);
+}
+
+template<typename SocketT>
+ssize_t WebSocketBase<SocketT>::writev(const struct iovec *iov, int iovcnt) {
+
+    if ((iovcnt + 1) >= ssize_t(iovecs_.size())) { iovecs_.resize(iovcnt + 1); }
+    // copy iovecs to local buffer, first iovec entry reserved for header
+    std::copy(iov, iov + iovcnt, iovecs_.data() + 1);
+
     // create header
     constexpr size_t kHSize = 20;
     char h_buffer[kHSize];
 
-    auto rc = ws_prepare(wsheader_type::BINARY_FRAME, true, mask, msglen, h_buffer, kHSize);
+    auto rc = frame_(iovecs_.data() + 1, iovcnt, h_buffer, kHSize);
     if (rc < 0) { return -1; }
 
     // send header + data
@@ -357,6 +362,51 @@ ssize_t WebSocketBase<SocketT>::writev(const struct iovec *iov, int iovcnt) {
     return sent;
 }
 
+template<typename SocketT>
+ssize_t WebSocketBase<SocketT>::try_writev(const struct iovec *iov, int iovcnt) {
+    return try_writev_messages(iov, &iovcnt, 1);
+}
+
+template<typename SocketT>
+ssize_t WebSocketBase<SocketT>::try_writev_messages(const struct iovec *iov, const int *counts, int msgcnt) {
+    constexpr size_t kHSize = 20;
+
+    // Framing masks the payload in place, so only frame what is written now
+    if (!SocketT::flush_pending()) return -1;
+    if (SocketT::has_pending_writes()) return 0;
+
+    int iovcnt = 0;
+    for (int i = 0; i < msgcnt; i++) { iovcnt += counts[i]; }
+
+    if (size_t(iovcnt + msgcnt) > iovecs_.size()) { iovecs_.resize(iovcnt + msgcnt); }
+    if (size_t(msgcnt) * kHSize > headers_.size()) { headers_.resize(msgcnt * kHSize); }
+
+    // header iovec followed by message iovecs, for each message
+    ssize_t header_total = 0;
+    struct iovec *out = iovecs_.data();
+    for (int i = 0; i < msgcnt; i++) {
+        char *header = headers_.data() + i * kHSize;
+        std::copy(iov, iov + counts[i], out + 1);
+
+        auto rc = frame_(out + 1, counts[i], header, kHSize);
+        if (rc < 0) { return -1; }
+
+        out[0].iov_base = header;
+        out[0].iov_len = rc;
+        header_total += rc;
+
+        out += counts[i] + 1;
+        iov += counts[i];
+    }
+
+    auto sent = SocketT::try_writev_whole_(iovecs_.data(), iovcnt + msgcnt);
+    if (sent > 0) {
+        // do not report sent header size
+        return sent - header_total;
+    }
+    return sent;
+}
+
 template<typename SocketT>
 ftl::URI::scheme_t WebSocketBase<SocketT>::scheme() const {return ftl::URI::SCHEME_TCP; }
 
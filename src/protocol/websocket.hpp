@@ -27,10 +27,22 @@ class WebSocketBase : public SocketT {
     bool prepare_next(char* buffer, size_t len, size_t &offset) override;
 
     ssize_t writev(const struct iovec *iov, int iovcnt) override;
+    // Whole frame is accepted or none of it, see try_writev_whole_()
+    ssize_t try_writev(const struct iovec *iov, int iovcnt) override;
+    // One frame per message, all frames accepted or none
+    ssize_t try_writev_messages(const struct iovec *iov, const int *counts, int msgcnt) override;
+    // Payload is masked in place
+    bool modifies_buffers() const override { return true; }
 
  protected:
     // output io vectors (incl. header)
     std::vector<struct iovec> iovecs_;
+    // frame headers for try_writev_messages()
+    std::vector<char> headers_;
+
+    // mask message payload in place and write frame header, returns header
+    // size or -1 on error
+    int frame_(struct iovec *iov, int iovcnt, char *header, size_t header_size);
 };
 
 using Connection_WS = WebSocketBase<Connection_TCP>;
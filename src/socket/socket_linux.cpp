@@ -71,6 +71,13 @@ ssize_t Socket::writev(const struct iovec *iov, int iovcnt) {
     return ::writev(fd_, iov, iovcnt);
 }
 
+ssize_t Socket::try_writev(const struct iovec *iov, int iovcnt) {
+    msghdr msg = {};
+    msg.msg_iov = const_cast<struct iovec*>(iov);
+    msg.msg_iovlen = iovcnt;
+    return ::sendmsg(fd_, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
 int Socket::bind(const SocketAddress &addr) {
     auto retval = ::bind(fd_, reinterpret_cast<const sockaddr*>(&addr.addr), addr.len);
     if (retval) {
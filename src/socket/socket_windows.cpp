@@ -134,6 +134,18 @@ ssize_t Socket::writev(const struct iovec* iov, int iovcnt) {
     return (err < 0) ? err : bytessent;
 }
 
+ssize_t Socket::try_writev(const struct iovec* iov, int iovcnt) {
+    // There is no MSG_DONTWAIT, so the socket is non-blocking for the
+    // duration of the call. A concurrent recv() may see WSAEWOULDBLOCK,
+    // which is not fatal.
+    u_long mode = 1;
+    ioctlsocket(fd_, FIONBIO, &mode);
+    auto sent = writev(iov, iovcnt);
+    mode = 0;
+    ioctlsocket(fd_, FIONBIO, &mode);
+    return sent;
+}
+
 int Socket::bind(const SocketAddress& addr) {
     CHECK(WinSock::isInitialized());
     CHECK(status_ == STATUS::UNCONNECTED);
@@ -40,6 +40,9 @@ class Socket {
     ssize_t send(const char* buffer, size_t len, int flags);
     ssize_t writev(const struct iovec *iov, int iovcnt);
 
+    /** writev() which does not block, may send only part of the data. */
+    ssize_t try_writev(const struct iovec *iov, int iovcnt);
+
     int bind(const SocketAddress&);
 
     int listen(int backlog);
@@ -5,22 +5,119 @@
  */
 
 #include <ftl/protocol/broadcaster.hpp>
+#include <ftl/threads.hpp>
+#include <ftl/exception.hpp>
 
 using ftl::protocol::Broadcast;
 using ftl::protocol::StreamPacket;
 using ftl::protocol::DataPacket;
 using ftl::protocol::Channel;
 using ftl::protocol::FrameID;
+using ftl::protocol::StreamProperty;
 
 Broadcast::Broadcast() {}
 
-Broadcast::~Broadcast() {}
+Broadcast::~Broadcast() {
+    clear();
+}
+
+void Broadcast::_startWorker(StreamEntry &entry) {
+    entry.worker = std::make_unique<Worker>();
+    entry.worker->slots.resize(queue_size_);
+
+    Worker *w = entry.worker.get();
+    auto stream = entry.stream;
+
+    w->thread = std::thread([w, stream]() {
+        ftl::set_thread_name("broadcast");
+
+        UNIQUE_LOCK(w->mtx, lk);
+        while (true) {
+            w->cv.wait(lk, [w]() { return w->size > 0 || !w->running; });
+            // Queued packets are still posted when stopping
+            if (w->size == 0) break;
+
+            // The slot is only reused once popped below
+            auto &slot = w->slots[w->head];
+            lk.unlock();
+            stream->post(slot.first, slot.second);
+            lk.lock();
+
+            w->head = (w->head + 1) % w->slots.size();
+            --w->size;
+        }
+    });
+}
+
+void Broadcast::_stopWorker(Worker &w) {
+    {
+        UNIQUE_LOCK(w.mtx, lk);
+        w.running = false;
+    }
+    w.cv.notify_one();
+    w.thread.join();
+}
+
+bool Broadcast::_enqueue(Worker &w, const StreamPacket &spkt, const DataPacket &pkt) {
+    {
+        UNIQUE_LOCK(w.mtx, lk);
+        if (w.size == w.slots.size()) {
+            ++w.drops;
+            return false;
+        }
+
+        // Copy assignment keeps the capacity of the slot's data
+        auto &slot = w.slots[(w.head + w.size) % w.slots.size()];
+        slot.first = spkt;
+        slot.second = pkt;
+        ++w.size;
+    }
+    w.cv.notify_one();
+    return true;
+}
+
+void Broadcast::setConcurrent(bool enabled, size_t queue) {
+    if (queue == 0) throw FTL_Error("Queue size must be at least 1");
+
+    // Posts wait until the workers are replaced, queued packets are posted first
+    UNIQUE_LOCK(post_mtx_, plk);
+
+    // Child streams may call back into this stream, so workers are not joined while locked
+    std::vector<std::unique_ptr<Worker>> workers;
+    {
+        UNIQUE_LOCK(mtx_, lk);
+        for (auto &s : streams_) {
+            if (s.worker) workers.push_back(std::move(s.worker));
+        }
+    }
+    for (auto &w : workers) _stopWorker(*w);
+
+    UNIQUE_LOCK(mtx_, lk);
+    concurrent_ = enabled;
+    queue_size_ = queue;
+
+    if (enabled) {
+        for (auto &s : streams_) _startWorker(s);
+    }
+}
+
+std::vector<size_t> Broadcast::dropCounts() const {
+    SHARED_LOCK(mtx_, lk);
+    std::vector<size_t> counts;
+    counts.reserve(streams_.size());
+    for (const auto &s : streams_) {
+        counts.push_back((s.worker) ? s.worker->drops.load() : 0);
+    }
+    return counts;
+}
 
 void Broadcast::add(const std::shared_ptr<Stream> &s) {
+    UNIQUE_LOCK(post_mtx_, plk);
     UNIQUE_LOCK(mtx_, lk);
 
     auto &entry = streams_.emplace_back();
     entry.stream = s;
+    if (concurrent_) _startWorker(entry);
 
     entry.handle = std::move(s->onPacket([this, s](const StreamPacket &spkt, const DataPacket &pkt) {
         trigger(spkt, pkt);
@@ -39,27 +136,47 @@ void Broadcast::add(const std::shared_ptr<Stream> &s) {
 }
 
 void Broadcast::remove(const std::shared_ptr<Stream> &s) {
-    UNIQUE_LOCK(mtx_, lk);
-    for (auto it = streams_.begin(); it != streams_.end(); ++it) {
-        if (it->stream == s) {
-            it->handle.cancel();
-            it->req_handle.cancel();
-            it->avail_handle.cancel();
-            streams_.erase(it);
-            break;
+    UNIQUE_LOCK(post_mtx_, plk);
+    std::unique_ptr<Worker> worker;
+    {
+        UNIQUE_LOCK(mtx_, lk);
+        for (auto it = streams_.begin(); it != streams_.end(); ++it) {
+            if (it->stream == s) {
+                it->handle.cancel();
+                it->req_handle.cancel();
+                it->avail_handle.cancel();
+                worker = std::move(it->worker);
+                streams_.erase(it);
+                break;
+            }
         }
     }
+    if (worker) _stopWorker(*worker);
 }
 
 void Broadcast::clear() {
-    UNIQUE_LOCK(mtx_, lk);
-    streams_.clear();
+    UNIQUE_LOCK(post_mtx_, plk);
+    std::vector<std::unique_ptr<Worker>> workers;
+    {
+        UNIQUE_LOCK(mtx_, lk);
+        for (auto &s : streams_) {
+            if (s.worker) workers.push_back(std::move(s.worker));
+        }
+        streams_.clear();
+    }
+    for (auto &w : workers) _stopWorker(*w);
 }
 
 bool Broadcast::post(const StreamPacket &spkt, const DataPacket &pkt) {
+    // Not mtx_, child streams may take it through callbacks while posting
+    SHARED_LOCK(post_mtx_, lk);
     bool status = true;
     for (auto &s : streams_) {
-        status = s.stream->post(spkt, pkt) && status;
+        if (s.worker) {
+            status = _enqueue(*s.worker, spkt, pkt) && status;
+        } else {
+            status = s.stream->post(spkt, pkt) && status;
+        }
     }
     return status;
 }
@@ -175,14 +292,32 @@ void Broadcast::disable(FrameID id, const ftl::protocol::ChannelSet &channels) {
     Stream::disable(id, channels);
 }
 
-void Broadcast::setProperty(ftl::protocol::StreamProperty opt, std::any value) {}
+void Broadcast::setProperty(ftl::protocol::StreamProperty opt, std::any value) {
+    switch (opt) {
+    case StreamProperty::kConcurrent        :   setConcurrent(std::any_cast<bool>(value)); break;
+    case StreamProperty::kDropCount         :   throw FTL_Error("Readonly property");
+    default                                 :   break;
+    }
+}
 
 std::any Broadcast::getProperty(ftl::protocol::StreamProperty opt) {
-    return 0;
+    switch (opt) {
+    case StreamProperty::kConcurrent        :   return isConcurrent();
+    case StreamProperty::kDropCount         :   {
+        size_t total = 0;
+        for (size_t drops : dropCounts()) total += drops;
+        return static_cast<int>(total);
+    }
+    default                                 :   return 0;
+    }
 }
 
 bool Broadcast::supportsProperty(ftl::protocol::StreamProperty opt) {
-    return false;
+    switch (opt) {
+    case StreamProperty::kConcurrent        :
+    case StreamProperty::kDropCount         :   return true;
+    default                                 :   return false;
+    }
 }
 
 ftl::protocol::StreamType Broadcast::type() const {
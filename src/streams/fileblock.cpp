@@ -0,0 +1,45 @@
+/**
+ * @file fileblock.cpp
+ * @copyright Copyright (c) 2022 University of Turku, MIT License
+ */
+
+#include <array>
+#include <cstring>
+#include "fileblock.hpp"
+
+using ftl::protocol::kBlockMagic;
+
+static std::array<uint32_t, 256> makeTable() {
+    std::array<uint32_t, 256> table;
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+    return table;
+}
+
+uint32_t ftl::protocol::crc32(const uint8_t *data, size_t size, uint32_t crc) {
+    static const auto table = makeTable();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+size_t ftl::protocol::findBlockMagic(const uint8_t *data, size_t size) {
+    if (size < sizeof(kBlockMagic)) return size;
+
+    const uint8_t first = kBlockMagic & 0xFF;
+    const uint8_t *end = data + size - sizeof(kBlockMagic) + 1;
+    for (const uint8_t *p = data; p < end; ++p) {
+        p = static_cast<const uint8_t*>(memchr(p, first, end - p));
+        if (!p) break;
+        if (memcmp(p, &kBlockMagic, sizeof(kBlockMagic)) == 0) return p - data;
+    }
+    return size;
+}
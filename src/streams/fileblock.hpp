@@ -0,0 +1,31 @@
+/**
+ * @file fileblock.hpp
+ * @copyright Copyright (c) 2022 University of Turku, MIT License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <ftl/protocol/packet.hpp>
+
+namespace ftl {
+namespace protocol {
+
+/** CRC-32 (IEEE 802.3) used for block checksums. */
+uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0);
+
+/**
+ * Find the first possible block header in a buffer, by its magic value.
+ * Returns the position or `size` if not found. It may be a false match, so
+ * the header and checksum must still be checked.
+ */
+size_t findBlockMagic(const uint8_t *data, size_t size);
+
+/** Check that a block header is valid for `available` bytes following it. */
+inline bool isBlockHeader(const BlockHeader &h, size_t available) {
+    return h.magic == kBlockMagic && h.size <= available;
+}
+
+}  // namespace protocol
+}  // namespace ftl
@@ -0,0 +1,65 @@
+/**
+ * @file fileindex.cpp
+ * @copyright Copyright (c) 2022 University of Turku, MIT License
+ */
+
+#include <algorithm>
+#include "fileindex.hpp"
+
+using ftl::protocol::FileIndex;
+using ftl::protocol::FileIndexEntry;
+using ftl::protocol::DataPacket;
+using ftl::protocol::Codec;
+
+void FileIndex::update() {
+    keyframes_.clear();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].flags & kIndexKeyFrame) keyframes_.push_back(i);
+    }
+}
+
+const FileIndexEntry *FileIndex::find(int64_t ts) const {
+    if (entries.empty() || ts < entries.front().timestamp) return nullptr;
+
+    if (keyframes_.empty()) {
+        auto it = std::upper_bound(entries.begin(), entries.end(), ts,
+            [](int64_t t, const FileIndexEntry &e) { return t < e.timestamp; });
+        return &*(--it);
+    }
+
+    auto it = std::upper_bound(keyframes_.begin(), keyframes_.end(), ts,
+        [this](int64_t t, size_t i) { return t < entries[i].timestamp; });
+    if (it == keyframes_.begin()) return &entries.front();
+    return &entries[*(--it)];
+}
+
+bool ftl::protocol::isPredictiveCodec(Codec codec) {
+    switch (codec) {
+    case Codec::kH264           :
+    case Codec::kH264Lossless   :
+    case Codec::kHEVC           :
+    case Codec::kHEVCLossLess   :   return true;
+    default                     :   return false;
+    }
+}
+
+bool ftl::protocol::isKeyFrame(const DataPacket &pkt) {
+    if (!isPredictiveCodec(pkt.codec)) return true;
+
+    const bool hevc = pkt.codec == Codec::kHEVC || pkt.codec == Codec::kHEVCLossLess;
+    const auto &d = pkt.data;
+
+    // Look at each NAL unit header following a 00 00 01 start code
+    for (size_t i = 2; i + 1 < d.size(); ++i) {
+        if (d[i] != 1 || d[i-1] != 0 || d[i-2] != 0) continue;
+
+        if (hevc) {
+            int type = (d[i+1] >> 1) & 0x3F;
+            if (type >= 16 && type <= 21) return true;  // IRAP
+        } else {
+            int type = d[i+1] & 0x1F;
+            if (type == 5) return true;  // IDR
+        }
+    }
+    return false;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file fileindex.hpp
+ * @copyright Copyright (c) 2022 University of Turku, MIT License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <ftl/protocol/packet.hpp>
+#include <msgpack.hpp>
+
+namespace ftl {
+namespace protocol {
+
+/** Entry is a valid starting point for decoding (contains a video key frame). */
+static constexpr uint8_t kIndexKeyFrame = 0x01;
+
+/** First value of an index block, "FTLI". */
+static constexpr uint32_t kIndexMagic = 0x494C5446;
+
+/** First value of a metadata block, "FTLM". */
+static constexpr uint32_t kMetadataMagic = 0x4D4C5446;
+
+/**
+ * One index entry per recorded timestamp, pointing at the first packet with
+ * that timestamp.
+ */
+struct FileIndexEntry {
+    int64_t timestamp = 0;   // Original timestamp as recorded
+    int64_t offset = 0;      // Byte offset from start of file
+    uint8_t flags = 0;
+
+    MSGPACK_DEFINE(timestamp, offset, flags);
+};
+
+/**
+ * Index block written at the end of a recording, the IndexHeader gives its
+ * offset. Entries are in file order with increasing timestamps.
+ */
+struct FileIndex {
+    uint32_t magic = kIndexMagic;
+    std::vector<FileIndexEntry> entries;
+
+    /**
+     * Find the last entry at or before a timestamp that decoding can start
+     * from. If there are no key frames (no video) then any entry is used.
+     * Returns nullptr if the timestamp is before the first entry.
+     */
+    const FileIndexEntry *find(int64_t ts) const;
+
+    /** Build the key frame list, must be called after loading entries. */
+    void update();
+
+    inline bool empty() const { return entries.empty(); }
+    inline int64_t duration() const { return (empty()) ? 0 : entries.back().timestamp - entries.front().timestamp; }
+
+    MSGPACK_DEFINE(magic, entries);
+
+ private:
+    std::vector<size_t> keyframes_;  // Entry positions of key frames
+};
+
+/** First recorded timestamp of a frameset. */
+struct FileFramesetInfo {
+    uint8_t id = 0;
+    int64_t first_ts = 0;
+
+    MSGPACK_DEFINE(id, first_ts);
+};
+
+/** A channel recorded for a frame. */
+struct FileChannelInfo {
+    uint8_t frameset = 0;
+    uint8_t frame = 0;
+    int channel = 0;
+
+    MSGPACK_DEFINE(frameset, frame, channel);
+};
+
+/**
+ * Summary of a whole recording, written directly after the index block so
+ * that a reader can start without scanning packets. Files without it are
+ * still scanned on open.
+ */
+struct FileMetadata {
+    uint32_t magic = kMetadataMagic;
+    int64_t duration = 0;       // Milliseconds from first to last timestamp
+    int64_t interval = 1000;    // Smallest gap between frames in milliseconds
+    int64_t frames = 0;         // Number of distinct frame timestamps
+    std::vector<FileFramesetInfo> framesets;
+    std::vector<FileChannelInfo> channels;
+    int segment = 0;            // Position in a segmented recording, 0 for the first file
+    bool continues = false;     // Recording continues in segment + 1
+
+    MSGPACK_DEFINE(magic, duration, interval, frames, framesets, channels, segment, continues);
+};
+
+/**
+ * Check if packet data can be decoded on its own. Only H264 and HEVC have
+ * dependent frames, the IDR and other intra random access units are looked
+ * for in the Annex B byte stream. All other codecs are self contained.
+ */
+bool isKeyFrame(const ftl::protocol::DataPacket &pkt);
+
+/** Is the codec one that has dependent (non key) frames. */
+bool isPredictiveCodec(ftl::protocol::Codec codec);
+
+}  // namespace protocol
+}  // namespace ftl
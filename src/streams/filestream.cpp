@@ -13,15 +13,21 @@
 #include <filesystem>
 #include <thread>
 #include <chrono>
+#include <typeinfo>
+#include <cstring>
+#include <memory>
 #include "filestream.hpp"
 #include <ftl/time.hpp>
 #include <ftl/counter.hpp>
 #include "packetMsgpack.hpp"
+#include "fileblock.hpp"
+#include "playbackscheduler.hpp"
 
 #define LOGURU_REPLACE_GLOG 1
 #include <loguru.hpp>
 
 using ftl::protocol::File;
+using ftl::protocol::PlaybackScheduler;
 using ftl::protocol::StreamPacket;
 using ftl::protocol::DataPacket;
 using ftl::protocol::Packet;
@@ -32,21 +38,40 @@ using ftl::protocol::PacketMSGPACK;
 using std::this_thread::sleep_for;
 using std::chrono::milliseconds;
 using ftl::protocol::StreamProperty;
+using ftl::protocol::FileIndex;
+using ftl::protocol::isKeyFrame;
+using ftl::protocol::isPredictiveCodec;
+using ftl::protocol::kIndexKeyFrame;
+using ftl::protocol::kIndexMagic;
+using ftl::protocol::FileMetadata;
+using ftl::protocol::kMetadataMagic;
+using ftl::protocol::BlockHeader;
+
+// Upper bound of the packed size of a packet without its data
+static constexpr size_t kMaxHeaderSize = 64;
+
+// Data is referenced in place instead of being copied into the zone, from the
+// mapping or the unpacker buffer (which the message handle keeps alive)
+static bool referenceData(msgpack::type::object_type, std::size_t, void*) {
+    return true;
+}
 
 File::File(const std::string &uri, bool writeable) :
         Stream(),
         uri_(uri),
         ostream_(nullptr),
         istream_(nullptr),
+        buffer_in_(&referenceData),
         active_(false) {
     mode_ = (writeable) ? Mode::Write : Mode::Read;
+    if (uri_.hasAttribute("mmap")) use_mmap_ = uri_.getAttribute<int>("mmap") != 0;
 }
 
-File::File(std::ifstream *is) : Stream(), ostream_(nullptr), istream_(is), active_(false) {
+File::File(std::ifstream *is) : Stream(), ostream_(nullptr), istream_(is), buffer_in_(&referenceData), active_(false) {
     mode_ = Mode::Read;
 }
 
-File::File(std::ofstream *os) : Stream(), ostream_(os), istream_(nullptr), active_(false) {
+File::File(std::ofstream *os) : Stream(), ostream_(os), istream_(nullptr), buffer_in_(&referenceData), active_(false) {
     mode_ = Mode::Write;
 }
 
@@ -54,9 +79,60 @@ File::~File() {
     end();
 }
 
+void File::_setTiming(int64_t frames, int64_t interval) {
+    is_video_ = frames > 991;
+
+    framerate_ = 1000 / interval;
+    if (!is_video_) {
+        looping_ = false;
+    }
+
+    interval_ = interval;
+    for (auto &f : framesets_) {
+        f.second.interval = interval_;
+    }
+}
+
 bool File::_checkFile() {
     if (!_open()) return false;
 
+    if (has_metadata_) {
+        std::unordered_set<FrameID> ids;
+        for (const auto &c : metadata_.channels) {
+            seen(FrameID(c.frameset, c.frame), static_cast<Channel>(c.channel));
+            ids.emplace(c.frameset, c.frame);
+        }
+        for (const auto &f : metadata_.framesets) {
+            framesets_[f.id].first_ts = f.first_ts;
+        }
+
+        // Frames first recorded in later segments
+        int64_t frames = metadata_.frames;
+        const int last_segment = _lastSegment();
+        for (int n = segment_ + 1; n <= last_segment; ++n) {
+            File segment(_segmentPath(n));
+            if (!segment._open() || !segment.has_metadata_) continue;
+            frames += segment.metadata_.frames;
+            for (const auto &c : segment.metadata_.channels) {
+                seen(FrameID(c.frameset, c.frame), static_cast<Channel>(c.channel));
+                ids.emplace(c.frameset, c.frame);
+            }
+            for (const auto &f : segment.metadata_.framesets) {
+                auto &fsdata = framesets_[f.id];
+                if (fsdata.first_ts < 0) fsdata.first_ts = f.first_ts;
+            }
+        }
+
+        // Non-persistent channels only become available at the end of a frame
+        for (const auto id : ids) {
+            seen(id, Channel::kEndFrame);
+        }
+
+        checked_ = true;
+        _setTiming(frames, metadata_.interval);
+        return true;
+    }
+
     // Read some packets to identify frame rate.
     int count = 1000;
     int64_t ts = -1000;
@@ -96,23 +172,64 @@ bool File::_checkFile() {
         }
     }
 
-    buffer_in_.reset();
-    buffer_in_.remove_nonparsed_buffer();
+    // Rewind for reading
+    _rewind();
 
     checked_ = true;
+    _setTiming(1000 - count, min_ts_diff);
+    return true;
+}
 
-    is_video_ = count < 9;
+int File::verify() {
+    auto map = MappedFile::open(uri_.toFilePath());
+    if (!map) return -1;
 
-    framerate_ = 1000 / min_ts_diff;
-    if (!is_video_) {
-        looping_ = false;
+    ftl::protocol::Header h;
+    ftl::protocol::IndexHeader ih;
+    const size_t start = sizeof(h) + sizeof(ih);
+    if (map->size() < start) return -1;
+    memcpy(reinterpret_cast<char*>(&h), map->data(), sizeof(h));
+    memcpy(reinterpret_cast<char*>(&ih), map->data() + sizeof(h), sizeof(ih));
+    if (h.magic[0] != 'F' || h.magic[1] != 'T' || h.magic[2] != 'L' || h.magic[3] != 'F') return -1;
+    if (h.version < ftl::protocol::kBlockFTLVersion) return -1;
+
+    const uint8_t *data = map->data();
+    const size_t end = (ih.index_offset >= static_cast<int64_t>(start) &&
+        ih.index_offset <= static_cast<int64_t>(map->size())) ? ih.index_offset : map->size();
+
+    // Walk the block headers, then check the block data in parallel
+    std::atomic_int bad = 0;
+    std::vector<std::pair<size_t, BlockHeader>> blocks;
+    size_t pos = start;
+    while (pos + sizeof(BlockHeader) <= end) {
+        BlockHeader bh;
+        memcpy(reinterpret_cast<char*>(&bh), data + pos, sizeof(bh));
+        if (ftl::protocol::isBlockHeader(bh, end - pos - sizeof(bh))) {
+            blocks.emplace_back(pos + sizeof(bh), bh);
+            pos += sizeof(bh) + bh.size;
+        } else {
+            ++bad;
+            pos += 1 + ftl::protocol::findBlockMagic(data + pos + 1, end - pos - 1);
+        }
     }
-
-    interval_ = min_ts_diff;
-    for (auto &f : framesets_) {
-        f.second.interval = interval_;
+    if (pos < end) ++bad;
+
+    const size_t step = std::max(size_t(1), blocks.size() / (4 * std::max(1, ftl::pool.size())));
+    {
+        ftl::threads::Batch batch;
+        for (size_t i = 0; i < blocks.size(); i += step) {
+            batch.add([&blocks, &bad, data, i, step]() {
+                const size_t last = std::min(blocks.size(), i + step);
+                for (size_t j = i; j < last; ++j) {
+                    const auto &bh = blocks[j].second;
+                    if (ftl::protocol::crc32(data + blocks[j].first, bh.size) != bh.checksum) ++bad;
+                }
+            });
+        }
+        batch.wait();
     }
-    return true;
+
+    return bad;
 }
 
 bool File::isValid() {
@@ -134,78 +251,562 @@ bool File::post(const StreamPacket &s, const DataPacket &p) {
     // Discard all data channel packets for now
     // if (!save_data_ && static_cast<int>(s.channel) >= static_cast<int>(ftl::codecs::Channel::Data)) return true;
 
+    if (write_buffer_size_ > 0) {
+        UNIQUE_LOCK(write_mtx_, lk);
+        if (!writing_ || write_error_) return false;
+
+        // Writer is still busy with the other buffer, the disk is not keeping up
+        if (write_front_.size() > 0 && write_front_.size() + p.data.size() + kMaxHeaderSize > write_buffer_size_) {
+            ++drop_count_;
+            return false;
+        }
+
+        _packPacket(write_front_, front_ends_, s, p);
+
+        lk.unlock();
+        write_cv_.notify_one();
+        return true;
+    }
+
+    UNIQUE_LOCK(mutex_, lk);
+
+    buffer_out_.clear();
+    _packPacket(buffer_out_, segment_ends_, s, p);
+    _writeBuffer(buffer_out_, segment_ends_);
+
+    if (sync_policy_ == SyncPolicy::kAlways ||
+            (sync_policy_ == SyncPolicy::kPeriodic && ftl::time::get_time() - last_sync_ >= sync_interval_)) {
+        _sync();
+    }
+    return ostream_->good();
+}
+
+void File::_packPacket(
+        msgpack::sbuffer &out,
+        std::vector<SegmentEnd> &ends,
+        const StreamPacket &s,
+        const DataPacket &p) {
+    if (_segmentFull(s)) _endSegment(out, ends);
+
     StreamPacket s2 = s;
 
     auto data = std::tie(
         *reinterpret_cast<const StreamPacketMSGPACK*>(&s2),
         *reinterpret_cast<const PacketMSGPACK*>(&p));
-    msgpack::sbuffer buffer;
-    msgpack::pack(buffer, data);
 
-    UNIQUE_LOCK(mutex_, lk);
+    if (format_version_ < ftl::protocol::kBlockFTLVersion) {
+        _indexPacket(s, p);
+        const size_t size = out.size();
+        msgpack::pack(out, data);
+        write_pos_ += out.size() - size;
+        return;
+    }
+
+    // Each timestamp starts a new block, so index entries point at blocks
+    if (block_.size() > 0 && s.timestamp != block_header_.timestamp) _packBlock(out);
+    if (block_.size() == 0) block_header_.timestamp = s.timestamp;
+
+    _indexPacket(s, p);
+    msgpack::pack(block_, data);
+    ++block_header_.count;
+}
+
+void File::_packBlock(msgpack::sbuffer &out) {
+    block_header_.size = static_cast<uint32_t>(block_.size());
+    block_header_.checksum = ftl::protocol::crc32(reinterpret_cast<const uint8_t*>(block_.data()), block_.size());
+
+    out.write(reinterpret_cast<const char*>(&block_header_), sizeof(block_header_));
+    out.write(block_.data(), block_.size());
+    write_pos_ += sizeof(block_header_) + block_.size();
+
+    block_.clear();
+    block_header_ = ftl::protocol::BlockHeader();
+}
+
+bool File::_segmentFull(const StreamPacket &s) const {
+    if (segment_size_ <= 0 && segment_duration_ <= 0) return false;
+
+    // Segments only change between timestamps, so each starts with whole frames
+    const auto &entries = index_.entries;
+    if (entries.empty() || s.timestamp <= entries.back().timestamp) return false;
+
+    return (segment_size_ > 0 && write_pos_ + static_cast<int64_t>(block_.size()) >= segment_size_) ||
+        (segment_duration_ > 0 && s.timestamp - entries.front().timestamp >= segment_duration_);
+}
+
+void File::_endSegment(msgpack::sbuffer &out, std::vector<SegmentEnd> &ends) {
+    if (block_.size() > 0) _packBlock(out);
+
+    // The index is written by whoever writes `out`, when it reaches this offset
+    auto &end = ends.emplace_back();
+    end.offset = out.size();
+    end.index_offset = write_pos_;
+    end.index = std::move(index_);
+    end.metadata = std::move(metadata_);
+    end.metadata.continues = true;
+
+    index_ = FileIndex();
+    metadata_ = FileMetadata();
+    metadata_.segment = end.metadata.segment + 1;
+    metadata_channels_.clear();
+    metadata_last_ts_ = 0;
+    write_pos_ = sizeof(ftl::protocol::Header) + sizeof(ftl::protocol::IndexHeader);
+}
+
+bool File::_startSegment(int n) {
+    segment_ = n;
+    const std::string path = _segmentPath(n);
+
+    ostream_->clear();
+    ostream_->open(path, std::ofstream::out | std::ofstream::binary);
+
+    if (!ostream_->good()) {
+        DLOG(ERROR) << "Could not open file: '" << path << "'";
+        return false;
+    }
+
+    ftl::protocol::Header h;
+    h.version = static_cast<uint8_t>(format_version_);
+    (*ostream_).write((const char*)&h, sizeof(h));
+
+    ftl::protocol::IndexHeader ih;
+    (*ostream_).write((const char*)&ih, sizeof(ih));
+    return true;
+}
+
+void File::_writeBuffer(const msgpack::sbuffer &buffer, std::vector<SegmentEnd> &ends) {
+    size_t pos = 0;
+    for (auto &end : ends) {
+        ostream_->write(buffer.data() + pos, end.offset - pos);
+        pos = end.offset;
+
+        _writeIndex(end.index, end.metadata, end.index_offset);
+        if (sync_policy_ != SyncPolicy::kNone) _sync();
+        ostream_->close();
+        _startSegment(segment_ + 1);
+    }
+    ends.clear();
+
+    if (buffer.size() > pos) ostream_->write(buffer.data() + pos, buffer.size() - pos);
+}
+
+std::string File::_segmentPath(int n) const {
+    const std::string path = uri_.toFilePath();
+    if (n == 0 || path.empty()) return path;
+
+    // "name.ftl" continues in "name.1.ftl", "name.2.ftl", ...
+    std::filesystem::path segment = std::filesystem::u8path(path);
+    segment.replace_extension(std::to_string(n) + segment.extension().u8string());
+    return segment.u8string();
+}
+
+void File::_indexPacket(const StreamPacket &s, const DataPacket &p) {
+    // Index the first packet of each new timestamp
+    auto &entries = index_.entries;
+    if (entries.empty() || s.timestamp > entries.back().timestamp) {
+        entries.push_back({s.timestamp, write_pos_, 0});
+    }
+    if (s.timestamp == entries.back().timestamp && isPredictiveCodec(p.codec) && isKeyFrame(p)) {
+        entries.back().flags |= kIndexKeyFrame;
+    }
+
+    // Gather the same information as a scan in _checkFile
+    auto &framesets = metadata_.framesets;
+    if (std::none_of(framesets.begin(), framesets.end(), [&s](const auto &f) { return f.id == s.streamID; })) {
+        framesets.push_back({s.streamID, s.timestamp});
+    }
+
+    const uint64_t key = (uint64_t(s.streamID) << 40) | (uint64_t(s.frame_number) << 32) |
+        static_cast<uint32_t>(s.channel);
+    if (metadata_channels_.insert(key).second) {
+        metadata_.channels.push_back({s.streamID, s.frame_number, static_cast<int>(s.channel)});
+    }
+
+    if (s.timestamp > 0 && static_cast<int>(s.channel) < 32 && s.timestamp > metadata_last_ts_) {
+        if (metadata_.frames > 0) {
+            metadata_.interval = std::min(metadata_.interval, s.timestamp - metadata_last_ts_);
+        }
+        ++metadata_.frames;
+        metadata_last_ts_ = s.timestamp;
+    }
+}
+
+void File::_writeThread() {
+    set_thread_name("filewriter");
+
+    UNIQUE_LOCK(write_mtx_, lk);
+    while (true) {
+        write_cv_.wait(lk, [this]() { return write_front_.size() > 0 || !writing_; });
+        if (write_front_.size() == 0) break;
+
+        // Posts continue into the other buffer while this one is written
+        std::swap(write_front_, write_back_);
+        std::swap(front_ends_, back_ends_);
+        lk.unlock();
+
+        _writeBuffer(write_back_, back_ends_);
+        write_back_.clear();
+
+        if (!ostream_->good()) {
+            LOG(ERROR) << "Recording write failed: " << _segmentPath(segment_);
+            write_error_ = true;
+        } else if (sync_policy_ == SyncPolicy::kAlways ||
+                (sync_policy_ == SyncPolicy::kPeriodic && ftl::time::get_time() - last_sync_ >= sync_interval_)) {
+            _sync();
+        }
+
+        lk.lock();
+    }
+}
+
+void File::_sync() {
+    ostream_->flush();
+    if (!ftl::protocol::syncFile(_segmentPath(segment_))) {
+        DLOG(WARNING) << "Could not sync file: " << _segmentPath(segment_);
+    }
+    last_sync_ = ftl::time::get_time();
+}
+
+void File::_configureWrite() {
+    if (uri_.hasAttribute("writebuffer")) {
+        write_buffer_size_ = std::max(0, uri_.getAttribute<int>("writebuffer"));
+    }
+    if (uri_.hasAttribute("syncinterval")) {
+        sync_interval_ = uri_.getAttribute<int>("syncinterval");
+    }
+    if (uri_.hasAttribute("version")) {
+        format_version_ = uri_.getAttribute<int>("version");
+    }
+    if (format_version_ != ftl::protocol::kCurrentFTLVersion && format_version_ != ftl::protocol::kBlockFTLVersion) {
+        LOG(WARNING) << "Cannot record file version " << format_version_;
+        format_version_ = ftl::protocol::kCurrentFTLVersion;
+    }
+    if (uri_.hasAttribute("sync")) {
+        const auto policy = uri_.getAttribute<std::string>("sync");
+        if (policy == "none") sync_policy_ = SyncPolicy::kNone;
+        else if (policy == "close") sync_policy_ = SyncPolicy::kOnClose;
+        else if (policy == "periodic") sync_policy_ = SyncPolicy::kPeriodic;
+        else if (policy == "always") sync_policy_ = SyncPolicy::kAlways;
+        else
+            LOG(WARNING) << "Unknown sync policy: " << policy;
+    }
+    if (uri_.hasAttribute("segmentsize")) {
+        segment_size_ = std::stoll(uri_.getAttribute<std::string>("segmentsize"));
+    }
+    if (uri_.hasAttribute("segmentduration")) {
+        segment_duration_ = std::stoll(uri_.getAttribute<std::string>("segmentduration"));
+    }
+}
+
+void File::_writeIndex(FileIndex &index, FileMetadata &metadata, int64_t offset) {
+    if (index.empty() || !ostream_->good()) return;
+
+    metadata.duration = index.duration();
+
+    msgpack::sbuffer buffer;
+    msgpack::pack(buffer, index);
+    msgpack::pack(buffer, metadata);
     ostream_->write(buffer.data(), buffer.size());
-    return ostream_->good();
+
+    ftl::protocol::IndexHeader ih;
+    ih.index_offset = offset;
+    ostream_->seekp(sizeof(ftl::protocol::Header));
+    ostream_->write(reinterpret_cast<const char*>(&ih), sizeof(ih));
+    ostream_->seekp(0, std::ios::end);
 }
 
-bool File::readPacket(Packet &data) {
+bool File::_readIndex(int64_t offset) {
+    if (offset <= 0) return false;
+
+    std::vector<char> buffer;
+    const char *data;
+    size_t size;
+
+    if (map_) {
+        if (static_cast<size_t>(offset) >= map_->size()) return false;
+        data = reinterpret_cast<const char*>(map_->data()) + offset;
+        size = map_->size() - offset;
+    } else {
+        istream_->seekg(0, std::ios::end);
+        int64_t end = istream_->tellg();
+        if (offset >= end) {
+            istream_->clear();
+            return false;
+        }
+
+        buffer.resize(end - offset);
+        istream_->seekg(offset);
+        istream_->read(buffer.data(), buffer.size());
+        if (istream_->gcount() != static_cast<std::streamsize>(buffer.size())) {
+            istream_->clear();
+            return false;
+        }
+        data = buffer.data();
+        size = buffer.size();
+    }
+
+    size_t off = 0;
+
+    try {
+        FileIndex index;
+        auto msg = msgpack::unpack(data, size, off);
+        msg.get().convert(index);
+        if (index.magic != kIndexMagic) return false;
+        index_ = std::move(index);
+    } catch (const std::exception &e) {
+        DLOG(WARNING) << "Bad file index: " << e.what();
+        return false;
+    }
+
+    index_.update();
+    data_end_ = offset;
+
+    // Older version 5 files end after the index
+    if (off < size) {
+        try {
+            FileMetadata metadata;
+            auto msg = msgpack::unpack(data, size, off);
+            msg.get().convert(metadata);
+            if (metadata.magic == kMetadataMagic) {
+                metadata_ = std::move(metadata);
+                has_metadata_ = true;
+            }
+        } catch (const std::exception &e) {
+            DLOG(WARNING) << "Bad file metadata: " << e.what();
+        }
+    }
+    return true;
+}
+
+bool File::_readAt(int64_t offset, char *data, size_t size) {
+    if (map_) {
+        if (offset < 0 || static_cast<size_t>(offset) + size > map_->size()) return false;
+        memcpy(data, map_->data() + offset, size);
+        return true;
+    }
+
+    istream_->clear();
+    istream_->seekg(offset);
+    istream_->read(data, size);
+    if (istream_->gcount() != static_cast<std::streamsize>(size)) {
+        istream_->clear();
+        return false;
+    }
+    return true;
+}
+
+int64_t File::_findBlock(int64_t from, int64_t end) {
+    char buffer[4096];
+    while (from + static_cast<int64_t>(sizeof(BlockHeader)) <= end) {
+        const size_t size = static_cast<size_t>(std::min(int64_t(sizeof(buffer)), end - from));
+        if (!_readAt(from, buffer, size)) return -1;
+
+        const size_t pos = ftl::protocol::findBlockMagic(reinterpret_cast<const uint8_t*>(buffer), size);
+        if (pos < size) return from + pos;
+
+        // Magic may straddle the end of this buffer
+        from += size - (sizeof(ftl::protocol::kBlockMagic) - 1);
+    }
+    return -1;
+}
+
+bool File::_nextBlock() {
+    const int64_t end = (data_end_ >= 0) ? data_end_ : file_size_;
+
+    while (read_pos_ + static_cast<int64_t>(sizeof(BlockHeader)) <= end) {
+        BlockHeader bh;
+        if (!_readAt(read_pos_, reinterpret_cast<char*>(&bh), sizeof(bh))) return false;
+        const int64_t start = read_pos_ + sizeof(bh);
+
+        if (ftl::protocol::isBlockHeader(bh, end - start)) {
+            const char *data;
+            if (map_) {
+                data = reinterpret_cast<const char*>(map_->data()) + start;
+            } else {
+                block_buffer_.resize(bh.size);
+                if (!_readAt(start, block_buffer_.data(), bh.size)) return false;
+                data = block_buffer_.data();
+            }
+
+            if (ftl::protocol::crc32(reinterpret_cast<const uint8_t*>(data), bh.size) == bh.checksum) {
+                block_data_ = data;
+                block_size_ = bh.size;
+                block_pos_ = 0;
+                read_pos_ = start + bh.size;
+                return true;
+            }
+        }
+
+        // Skip damaged data up to the next block
+        LOG(WARNING) << "Corrupt block in recording at " << read_pos_ << ": " << _segmentPath(segment_);
+        read_pos_ = _findBlock(read_pos_ + 1, end);
+        if (read_pos_ < 0) {
+            read_pos_ = end;
+            return false;
+        }
+    }
+    return false;
+}
+
+bool File::_nextObject(msgpack::object &obj) {
+    // The end of a segment continues into the next one
+    while (!_readObject(obj)) {
+        if (!_nextSegment()) return false;
+    }
+    return true;
+}
+
+bool File::_readObject(msgpack::object &obj) {
+    if (version_ >= ftl::protocol::kBlockFTLVersion) {
+        while (true) {
+            if (block_pos_ >= block_size_ && !_nextBlock()) return false;
+
+            try {
+                zone_.clear();
+                obj = msgpack::unpack(zone_, block_data_, block_size_, block_pos_, &referenceData);
+                return true;
+            } catch (const std::exception &e) {
+                // Checksum was correct, so the writer produced this, skip the block
+                DLOG(INFO) << "Corrupt message: " << e.what();
+                block_pos_ = block_size_;
+            }
+        }
+    }
+
+    if (map_) {
+        const size_t end = (data_end_ >= 0) ? static_cast<size_t>(data_end_) : map_->size();
+        size_t offset = static_cast<size_t>(read_pos_);
+        if (offset >= end) return false;
+
+        try {
+            zone_.clear();
+            obj = msgpack::unpack(zone_, reinterpret_cast<const char*>(map_->data()), end, offset, &referenceData);
+        } catch (const std::exception &e) {
+            // Truncated or corrupt, such as the tail of an interrupted recording
+            DLOG(INFO) << "Corrupt message: " << (end - read_pos_) << " - " << e.what();
+            return false;
+        }
+
+        read_pos_ = offset;
+        return true;
+    }
+
     bool partial = false;
-    ftl::protocol::Packer pack;
 
     while ((istream_->good()) || buffer_in_.nonparsed_size() > 0u) {
         if (buffer_in_.nonparsed_size() == 0 || (partial && buffer_in_.nonparsed_size() < 10000000)) {
             buffer_in_.reserve_buffer(10000000);
-            istream_->read(buffer_in_.buffer(), buffer_in_.buffer_capacity());
+
+            // Don't read into the index block
+            int64_t size = buffer_in_.buffer_capacity();
+            if (data_end_ >= 0) size = std::min(size, data_end_ - read_pos_);
+            if (size <= 0) return false;
+
+            istream_->read(buffer_in_.buffer(), size);
             // if (stream_->bad()) return false;
 
             int bytes = istream_->gcount();
             if (bytes == 0) return false;
             buffer_in_.buffer_consumed(bytes);
+            read_pos_ += bytes;
             partial = false;
         }
 
-        msgpack::object_handle msg;
-        if (!buffer_in_.next(msg)) {
-            partial = true;
-            continue;
+        try {
+            if (!buffer_in_.next(msg_)) {
+                partial = true;
+                continue;
+            }
+        } catch (const std::exception &e) {
+            // As for the mapping, corrupt data ends the recording
+            DLOG(INFO) << "Corrupt message: " << e.what();
+            return false;
         }
 
-        msgpack::object obj = msg.get();
+        obj = msg_.get();
+        return true;
+    }
 
-        try {
-            // Older versions have a different SPKT structure.
-            if (version_ < 5) {
-                /*std::tuple<StreamPacketV4MSGPACK, PacketMSGPACK> datav4;
-                obj.convert(datav4);
-
-                auto &spkt = std::get<0>(data);
-                auto &spktv4 = std::get<0>(datav4);
-                spkt.version = 4;
-                spkt.streamID = spktv4.streamID;
-                spkt.channel = spktv4.channel;
-                spkt.frame_number = spktv4.frame_number;
-                spkt.timestamp = spktv4.timestamp;
-                spkt.flags = 0;
+    return false;
+}
 
-                std::get<1>(data) = std::move(std::get<1>(datav4));*/
-                error(ftl::protocol::Error::kBadVersion, "Version too old");
-                return false;
-            } else {
-                pack.set(&data);
-                obj.convert(pack);
-            }
-        } catch (std::exception &e) {
-            DLOG(INFO) << "Corrupt message: " << buffer_in_.nonparsed_size() << " - " << e.what();
-            // active_ = false;
+bool File::readPacket(Packet &data) {
+    msgpack::object obj;
+    if (!_nextObject(obj)) return false;
+    return _convertPacket(obj, data);
+}
+
+bool File::_convertHeader(const msgpack::object &obj, StreamPacket &spkt) {
+    if (version_ < 5) {
+        error(ftl::protocol::Error::kBadVersion, "Version too old");
+        return false;
+    }
+    if (obj.type != msgpack::type::ARRAY || obj.via.array.size < 2) return false;
+
+    try {
+        ftl::protocol::StreamPacker pack(&spkt);
+        obj.via.array.ptr[0].convert(pack);
+    } catch (std::exception &e) {
+        DLOG(INFO) << "Corrupt message: " << e.what();
+        return false;
+    }
+    return true;
+}
+
+bool File::_convertPacket(const msgpack::object &obj, Packet &data) {
+    try {
+        // Older versions have a different SPKT structure.
+        if (version_ < 5) {
+            /*std::tuple<StreamPacketV4MSGPACK, PacketMSGPACK> datav4;
+            obj.convert(datav4);
+
+            auto &spkt = std::get<0>(data);
+            auto &spktv4 = std::get<0>(datav4);
+            spkt.version = 4;
+            spkt.streamID = spktv4.streamID;
+            spkt.channel = spktv4.channel;
+            spkt.frame_number = spktv4.frame_number;
+            spkt.timestamp = spktv4.timestamp;
+            spkt.flags = 0;
+
+            std::get<1>(data) = std::move(std::get<1>(datav4));*/
+            error(ftl::protocol::Error::kBadVersion, "Version too old");
             return false;
+        } else {
+            ftl::protocol::Packer pack(&data);
+            obj.convert(pack);
         }
+    } catch (std::exception &e) {
+        DLOG(INFO) << "Corrupt message: " << e.what();
+        // active_ = false;
+        return false;
+    }
 
-        // Correct for older version differences.
-        // _patchPackets(&std::get<0>(data), &std::get<1>(data));
+    // Correct for older version differences.
+    // _patchPackets(&std::get<0>(data), &std::get<1>(data));
 
-        return true;
+    return true;
+}
+
+bool File::readPacket(FilePacketView &view) {
+    msgpack::object obj;
+    if (!_nextObject(obj)) return false;
+
+    if (version_ < 5) {
+        error(ftl::protocol::Error::kBadVersion, "Version too old");
+        return false;
     }
 
-    return false;
+    try {
+        ftl::protocol::ViewPacker pack(&view.spkt, &view.pkt);
+        obj.convert(pack);
+    } catch (std::exception &e) {
+        DLOG(INFO) << "Corrupt message: " << e.what();
+        return false;
+    }
+
+    view.mapping = map_;
+    return true;
 }
 
 void File::_patchPackets(StreamPacket *spkt, DataPacket *pkt) {
@@ -251,40 +852,50 @@ bool File::tick(int64_t ts) {
         return true;
     }
 
+    _releaseFrames(ts);
+    return _readAhead();
+}
+
+void File::_releaseFrames(int64_t ts) {
+    // Packets given to jobs by the last tick are finished with
+    _popPackets(data_dispatched_);
+    data_dispatched_ = 0;
+    batches_.clear();
+
     // Check buffer first for frames already read
     size_t complete_count = 0;
+    size_t i = 0;
 
-    for (auto i = data_.begin(); i != data_.end(); ) {
-        auto &fsdata = framesets_[i->streamID];
-        if (fsdata.timestamp == 0) fsdata.timestamp = i->timestamp;
+    while (i < data_size_) {
+        const size_t slot = (data_head_ + i) % data_.size();
+        Packet &pkt = data_[slot].packet;
+
+        auto &fsdata = framesets_[pkt.streamID];
+        if (fsdata.timestamp == 0) fsdata.timestamp = pkt.timestamp;
 
         // Limit to file framerate
-        if (i->timestamp > ts) {
+        if (pkt.timestamp > ts) {
             break;
         }
 
-        // Is the packet too old?
-        if (i->timestamp < fsdata.timestamp) {
-            i = data_.erase(i);
+        // Is the packet too old? It is released along with dispatched packets.
+        if (pkt.timestamp < fsdata.timestamp) {
+            ++i;
             continue;
         }
 
-        if (i->timestamp <= fsdata.timestamp) {
-            StreamPacket &spkt = *i;
-
-            if (spkt.channel == Channel::kEndFrame) {
+        if (pkt.timestamp <= fsdata.timestamp) {
+            if (pkt.channel == Channel::kEndFrame) {
                 fsdata.needs_endframe = false;
             }
 
             if (fsdata.needs_endframe) {
-                if (spkt.frame_number < 255) {
-                    Packet &pkt = *i;
-
+                if (pkt.frame_number < 255) {
                     fsdata.frame_count = std::max(
                         fsdata.frame_count,
-                        static_cast<size_t>(spkt.frame_number + pkt.frame_count));
-                    while (fsdata.packet_counts.size() <= spkt.frame_number) fsdata.packet_counts.push_back(0);
-                    ++fsdata.packet_counts[spkt.frame_number];
+                        static_cast<size_t>(pkt.frame_number + pkt.frame_count));
+                    while (fsdata.packet_counts.size() <= pkt.frame_number) fsdata.packet_counts.push_back(0);
+                    ++fsdata.packet_counts[pkt.frame_number];
                 } else {
                     // Add frameset packets to frame 0 counts
                     fsdata.frame_count = std::max(fsdata.frame_count, size_t(1));
@@ -293,75 +904,69 @@ bool File::tick(int64_t ts) {
                 }
             }
 
-            auto j = i;
-            ++i;
-
-            // TODO(Nick): Probably better not to do a thread per packet
-            ftl::pool.push([this, c = std::move(ftl::Counter(&jobs_)), i = j](int id) {
-                StreamPacket &spkt = *i;
-                Packet &pkt = *i;
-
-                spkt.localTimestamp = spkt.timestamp;
-
-                trigger(spkt, pkt);
+            // Append to the list of packets for this frame
+            auto &batch = _getBatch(pkt.timestamp, pkt.streamID, pkt.frame_number);
+            data_[slot].next = kNoPacket;
+            if (batch.last == kNoPacket) {
+                batch.first = slot;
+            } else {
+                data_[batch.last].next = slot;
+            }
+            batch.last = slot;
 
-                UNIQUE_LOCK(data_mutex_, dlk);
-                data_.erase(i);
-            });
+            ++i;
         } else {
             ++complete_count;
 
             if (fsdata.needs_endframe) {
                 for (size_t j = 0; j < fsdata.frame_count; ++j) {
-                    auto timestamp = fsdata.timestamp;
-                    auto sid = i->streamID;
-                    auto pcount = fsdata.packet_counts[j];
-
-                    ftl::pool.push([this, timestamp, sid, j, pcount](int id) {
-                        // Send final frame packet.
-                        StreamPacket spkt;
-                        spkt.timestamp = timestamp;
-                        spkt.streamID = sid;
-                        spkt.flags = 0;
-                        spkt.channel = Channel::kEndFrame;
-
-                        DataPacket pkt;
-                        pkt.bitrate = 255;
-                        pkt.codec = Codec::kInvalid;
-                        pkt.packet_count = 1;
-                        pkt.frame_count = 1;
-
-                        spkt.frame_number = j;
-                        pkt.packet_count = pcount+1;
-
-                        trigger(spkt, pkt);
-                    });
-
+                    auto &batch = _getBatch(fsdata.timestamp, pkt.streamID, static_cast<uint8_t>(j));
+                    batch.end_count = fsdata.packet_counts[j] + 1;
                     fsdata.packet_counts[j] = 0;
                 }
-            } else {
             }
 
-            fsdata.timestamp = i->timestamp;
+            fsdata.timestamp = pkt.timestamp;
             if (complete_count == framesets_.size()) break;
         }
     }
 
+    // Everything before i has been dispatched or skipped
+    data_dispatched_ = i;
+    for (const auto &batch : batches_) _dispatch(batch);
+}
+
+bool File::_readAhead() {
     int64_t max_ts = std::numeric_limits<int64_t>::min();
     for (auto &fsd : framesets_) {
         max_ts = std::max(max_ts, (fsd.second.timestamp <= 0) ? timestart_ : fsd.second.timestamp);
     }
     int64_t extended_ts = max_ts + 200;  // Buffer 200ms ahead
 
-    while (!read_error_ && ((active_ && istream_->good()) || buffer_in_.nonparsed_size() > 0u)) {
-        UNIQUE_LOCK(data_mutex_, dlk);
-        auto &data = data_.emplace_back();
-        dlk.unlock();
+    UNIQUE_LOCK(filter_mtx_, flk);
+
+    while (!read_error_ && active_) {
+        Packet *next = _pushPacket();
+        if (!next) break;  // Buffer full until running jobs are done
+        auto &data = *next;
+
+        msgpack::object obj;
+        if (!_nextObject(obj) || !_convertHeader(obj, data)) {
+            --data_size_;
+            read_error_ = true;
+            break;
+        }
+
+        // Only the header is decoded for unwanted packets, their data is left in place
+        if (!_isWanted(data)) {
+            --data_size_;
+            auto &fsdata = framesets_[data.streamID];
+            if (data.timestamp - fsdata.first_ts + timestart_ > extended_ts) break;
+            continue;
+        }
 
-        bool res = readPacket(data);
-        if (!res) {
-            dlk.lock();
-            data_.pop_back();
+        if (!_convertPacket(obj, data)) {
+            --data_size_;
             read_error_ = true;
             break;
         }
@@ -383,8 +988,10 @@ bool File::tick(int64_t ts) {
         }
     }
 
+    flk.unlock();
+
     // Force send end frames for static files
-    if (data_.size() == 0 && !is_video_) {
+    if (data_size_ == 0 && !is_video_) {
         for (auto &fsix : framesets_) {
             auto &fsdata = fsix.second;
             if (fsdata.needs_endframe) {
@@ -413,68 +1020,400 @@ bool File::tick(int64_t ts) {
         }
     }
 
-    if (data_.size() == 0 && looping_) {
-        buffer_in_.reset();
-        buffer_in_.remove_nonparsed_buffer();
-        _open();
-
-        read_error_ = false;
+    if (data_size_ == 0 && looping_) {
+        _rewind();
         timestart_ = ftl::time::get_time();
-        for (auto &fsd : framesets_) fsd.second.timestamp = 0;
+        _resetClock(timestart_);
         return true;
     }
 
-    return data_.size() > 0;
+    return data_size_ > 0;
 }
 
 bool File::_open() {
+    if (!map_ && !istream_ && use_mmap_) {
+        map_ = MappedFile::open(_segmentPath(segment_));
+    }
+    if (map_) return _openMapped();
+
     if (istream_ && istream_->is_open()) {
         istream_->clear();
         istream_->seekg(0);
     } else {
         if (!istream_) istream_ = new std::ifstream;
-        istream_->open(uri_.toFilePath(), std::ifstream::in | std::ifstream::binary);
+        istream_->open(_segmentPath(segment_), std::ifstream::in | std::ifstream::binary);
 
         if (!istream_->good()) {
-            DLOG(ERROR) << "Could not open file: " << uri_.toFilePath();
+            DLOG(ERROR) << "Could not open file: " << _segmentPath(segment_);
             return false;
         }
     }
 
+    istream_->seekg(0, std::ios::end);
+    file_size_ = istream_->tellg();
+    istream_->seekg(0);
+
     ftl::protocol::Header h;
     (*istream_).read(reinterpret_cast<char*>(&h), sizeof(h));
     if (h.magic[0] != 'F' || h.magic[1] != 'T' || h.magic[2] != 'L' || h.magic[3] != 'F') return false;
 
+    data_start_ = sizeof(h);
+
     if (h.version >= 2) {
         ftl::protocol::IndexHeader ih;
         (*istream_).read(reinterpret_cast<char*>(&ih), sizeof(ih));
+        data_start_ += sizeof(ih);
+
+        // Only version 5 writers initialise the index offset
+        if (h.version >= 5 && !index_checked_) {
+            index_checked_ = true;
+            _readIndex(ih.index_offset);
+            istream_->seekg(data_start_);
+        }
     }
 
+    read_pos_ = data_start_;
     version_ = h.version;
     return true;
 }
 
-bool File::run() {
-    thread_ = std::thread([this]() {
-        set_thread_name("filestream");
-        while (active_) {
-            auto now = ftl::time::get_time();
-            tick(now);
-            auto used = ftl::time::get_time() - now;
-            int64_t spare = interval_ - used;
-            // LOG(INFO) << "SLEEP = " << spare;
-            sleep_for(milliseconds(std::max(int64_t(1), spare)));
+bool File::_openMapped() {
+    ftl::protocol::Header h;
+    if (map_->size() < sizeof(h)) return false;
+    memcpy(reinterpret_cast<char*>(&h), map_->data(), sizeof(h));
+    if (h.magic[0] != 'F' || h.magic[1] != 'T' || h.magic[2] != 'L' || h.magic[3] != 'F') return false;
+
+    file_size_ = map_->size();
+
+    data_start_ = sizeof(h);
+
+    if (h.version >= 2) {
+        ftl::protocol::IndexHeader ih;
+        if (map_->size() < sizeof(h) + sizeof(ih)) return false;
+        memcpy(reinterpret_cast<char*>(&ih), map_->data() + sizeof(h), sizeof(ih));
+        data_start_ += sizeof(ih);
+
+        if (h.version >= 5 && !index_checked_) {
+            index_checked_ = true;
+            _readIndex(ih.index_offset);
+        }
+    }
+
+    read_pos_ = data_start_;
+    version_ = h.version;
+    return true;
+}
+
+void File::_seekOffset(int64_t offset) {
+    block_pos_ = 0;
+    block_size_ = 0;
+    data_head_ = 0;
+    data_size_ = 0;
+    data_dispatched_ = 0;
+    buffer_in_.reset();
+    buffer_in_.remove_nonparsed_buffer();
+
+    if (istream_) {
+        istream_->clear();
+        istream_->seekg(offset);
+    }
+    read_pos_ = offset;
+    read_error_ = false;
+
+    for (auto &fsd : framesets_) {
+        fsd.second.timestamp = 0;
+        std::fill(fsd.second.packet_counts.begin(), fsd.second.packet_counts.end(), 0);
+    }
+}
+
+bool File::_openSegment(int n) {
+    if (istream_) istream_->close();
+    map_.reset();
+    buffer_in_.reset();
+    buffer_in_.remove_nonparsed_buffer();
+    block_pos_ = 0;
+    block_size_ = 0;
+
+    // Each segment has its own index
+    index_ = FileIndex();
+    index_checked_ = false;
+    has_metadata_ = false;
+    data_end_ = -1;
+    segment_ = n;
+
+    if (!_open()) {
+        LOG(WARNING) << "Could not open recording segment: " << _segmentPath(n);
+        return false;
+    }
+    return true;
+}
+
+bool File::_nextSegment() {
+    if (mode_ != Mode::Read || !_continues()) return false;
+    return _openSegment(segment_ + 1);
+}
+
+bool File::_continues() const {
+    // A file named like a segment may be unrelated, only the metadata says so.
+    // A segment opened on its own has the wrong number and is read alone.
+    return has_metadata_ && metadata_.continues && metadata_.segment == segment_;
+}
+
+int File::_lastSegment() const {
+    int n = segment_;
+    if (!_continues()) return n;
+
+    while (true) {
+        File segment(_segmentPath(n + 1));
+        if (!segment._open()) return n;
+        if (segment.has_metadata_ && segment.metadata_.segment != n + 1) return n;
+        ++n;
+        // The last segment of an unfinished recording has no metadata
+        if (!segment.has_metadata_ || !segment.metadata_.continues) return n;
+    }
+}
+
+void File::_removeSegments() {
+    int last_segment = 0;
+    {
+        File recording(_segmentPath(0));
+        if (!recording._open()) return;
+        last_segment = recording._lastSegment();
+    }
+
+    for (int n = 1; n <= last_segment; ++n) {
+        std::error_code ec;
+        std::filesystem::remove(std::filesystem::u8path(_segmentPath(n)), ec);
+    }
+}
+
+bool File::_segmentRange(int n, int64_t &first, int64_t &last) {
+    const FileIndex *index = &index_;
+
+    // Only the header and index of other segments are read
+    std::unique_ptr<File> segment;
+    if (n != segment_) {
+        const std::string path = _segmentPath(n);
+        if (path.empty() || !std::filesystem::exists(std::filesystem::u8path(path))) return false;
+        segment = std::make_unique<File>(path);
+        if (!segment->_open()) return false;
+        index = &segment->index_;
+    }
+
+    if (index->empty()) return false;
+    first = index->entries.front().timestamp;
+    last = index->entries.back().timestamp;
+    return true;
+}
+
+void File::_rewind() {
+    if (segment_ != 0) _openSegment(0);
+    _seekOffset(data_start_);
+}
+
+Packet *File::_pushPacket() {
+    if (data_size_ == data_.size()) {
+        // Jobs hold slots, so only grow once they are done
+        if (jobs_ > 0) return nullptr;
+
+        std::vector<BufferedPacket> buffer(std::max(size_t(32), data_.size() * 2));
+        for (size_t i = 0; i < data_.size(); ++i) {
+            buffer[i] = std::move(data_[(data_head_ + i) % data_.size()]);
         }
+        data_.swap(buffer);
+        data_head_ = 0;
+    }
+
+    auto &pkt = data_[(data_head_ + data_size_) % data_.size()].packet;
+    ++data_size_;
+
+    // Slot data capacity is kept, but clear fields not read from the file
+    static_cast<StreamPacket&>(pkt) = StreamPacket();
+    return &pkt;
+}
+
+void File::_popPackets(size_t n) {
+    if (n == 0) return;
+    data_head_ = (data_head_ + n) % data_.size();
+    data_size_ -= n;
+}
+
+File::FrameBatch &File::_getBatch(int64_t ts, uint8_t sid, uint8_t frame) {
+    for (auto &b : batches_) {
+        if (b.timestamp == ts && b.streamID == sid && b.frame_number == frame) return b;
+    }
+    auto &b = batches_.emplace_back();
+    b.timestamp = ts;
+    b.streamID = sid;
+    b.frame_number = frame;
+    return b;
+}
+
+void File::_dispatch(const FrameBatch &batch) {
+    ftl::pool.post([this, c = ftl::Counter(&jobs_), batch](int id) mutable {
+        for (size_t slot = batch.first; slot != kNoPacket; slot = data_[slot].next) {
+            Packet &pkt = data_[slot].packet;
+            pkt.localTimestamp = pkt.timestamp;
+            trigger(pkt, pkt);
+        }
+
+        if (batch.end_count >= 0) {
+            // Send final frame packet.
+            StreamPacket spkt;
+            spkt.timestamp = batch.timestamp;
+            spkt.streamID = batch.streamID;
+            spkt.frame_number = batch.frame_number;
+            spkt.flags = 0;
+            spkt.channel = Channel::kEndFrame;
+
+            DataPacket pkt;
+            pkt.bitrate = 255;
+            pkt.codec = Codec::kInvalid;
+            pkt.frame_count = 1;
+            pkt.packet_count = batch.end_count;
+
+            trigger(spkt, pkt);
+        }
+
+        _jobDone(std::move(c), true);
     });
+}
+
+void File::_jobDone(ftl::Counter &&job, bool progress) {
+    // Keeps end() waiting until this has returned
+    ftl::Counter finishing(&finishing_);
+    { auto done = std::move(job); }
 
-    #ifndef WIN32
-    sched_param p;
-    p.sched_priority = sched_get_priority_max(SCHED_RR);
-    pthread_setschedparam(thread_.native_handle(), SCHED_RR, &p);
+    // Unthrottled playback steps again once the last job has finished
+    if (progress && jobs_ == 0 && reads_ == 0 && speed_ <= 0.0f && active_) {
+        PlaybackScheduler::getInstance().wake(this);
+    }
+}
+
+bool File::seek(int64_t position) {
+    if (!active_ || mode_ != Mode::Read) return false;
+
+    UNIQUE_LOCK(mutex_, lk);
+
+    // Packets in data_ are referenced by running jobs
+    while (jobs_ > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    int64_t start;
+    int64_t first;
+    int64_t last;
+    if (!_segmentRange(0, start, last)) return false;
+    const int64_t target = start + std::max(int64_t(0), position);
+
+    // Segment containing the position, or the last segment
+    const int last_segment = _lastSegment();
+    int n = 0;
+    while (last < target && n < last_segment && _segmentRange(n + 1, first, last)) ++n;
+    if (n != segment_ && !_openSegment(n)) return false;
+    if (index_.empty()) return false;
+
+    const auto *entry = index_.find(target);
+    if (!entry) entry = &index_.entries.front();
+
+    _seekOffset(entry->offset);
+
+    // Timestamps continue from now, as if the recording started earlier
+    const int64_t now = ftl::time::get_time();
+    timestart_ = now - (entry->timestamp - start);
+    _resetClock(now);
+
+    // Playback may have stopped at the end of the file
+    PlaybackScheduler::getInstance().wake(this);
+    return true;
+}
+
+int64_t File::duration() {
+    if (!index_checked_ && mode_ == Mode::Read) _open();
+
+    const int last_segment = (mode_ == Mode::Read) ? _lastSegment() : 0;
+    if (last_segment == 0) return (has_metadata_) ? metadata_.duration : index_.duration();
+
+    // From the start of the first segment to the end of the last
+    UNIQUE_LOCK(mutex_, lk);
+    int64_t first;
+    int64_t last;
+    int64_t unused;
+    if (!_segmentRange(0, first, unused) || !_segmentRange(last_segment, unused, last)) return 0;
+    return last - first;
+}
+
+int64_t File::position() const {
+    int64_t pos = 0;
+    for (const auto &fsd : framesets_) {
+        if (fsd.second.timestamp > 0) pos = std::max(pos, fsd.second.timestamp - timestart_);
+    }
+    return pos;
+}
+
+int64_t File::_playbackTime(int64_t now) const {
+    if (speed_ <= 0.0f) return std::numeric_limits<int64_t>::max();
+    return clock_base_ + static_cast<int64_t>(static_cast<double>(now - clock_wall_) * speed_);
+}
+
+void File::_resetClock(int64_t now) {
+    clock_base_ = now;
+    clock_wall_ = now;
+}
+
+void File::setSpeed(float speed) {
+    UNIQUE_LOCK(mutex_, lk);
+    // Continue from the current position at the new speed
+    const int64_t now = ftl::time::get_time();
+    clock_base_ = (active_) ? timestart_ + position() : now;
+    clock_wall_ = now;
+    speed_ = std::max(0.0f, speed);
+    if (active_) PlaybackScheduler::getInstance().wake(this);
+}
+
+int64_t File::_step(int64_t now) {
+    if (!active_) return 1000000;
+
+    // Only frames already read are released on the scheduler thread, it is
+    // shared by all files so reading ahead is left to the thread pool.
+    #ifdef DEBUG_MUTEX
+    UNIQUE_LOCK(mutex_, lk);
+    #else
+    std::unique_lock<std::mutex> lk(mutex_, std::defer_lock);
+    if (!lk.try_lock()) return 1000;  // Read ahead or seek in progress
     #endif
 
-    // TODO(Nick): Windows thread priority
+    const int64_t ts = _playbackTime(now);
+    float speed = speed_;
+    if (jobs_ == 0 && reads_ == 0) {
+        _releaseFrames(ts);
+
+        ftl::pool.post([this, c = ftl::Counter(&reads_)](int id) mutable {
+            bool progress = false;
+            {
+                UNIQUE_LOCK(mutex_, lk);
+                const size_t size = data_size_;
+                if (active_) _readAhead();
+                progress = data_size_ > size;
+            }
+            // Nothing more to read, so a step would not release anything new
+            _jobDone(std::move(c), progress);
+        });
+    }
+    lk.unlock();
+
+    // Unthrottled, the last job of this step wakes the next one, see
+    // _jobDone(). The frame interval is only a fallback.
+    if (speed <= 0.0f) speed = 1.0f;
+
+    // Wake on the frame interval grid, shared by files of the same rate
+    const int64_t period = std::max(int64_t(1000), static_cast<int64_t>(interval_ * 1000.0f / speed));
+    const int64_t now_us = ftl::time::get_time() * 1000;
+    return (now * 1000 / period + 1) * period - now_us;
+}
 
+bool File::run() {
+    PlaybackScheduler::getInstance().add(this, [this](int64_t now) { return _step(now); });
     return true;
 }
 
@@ -495,10 +1434,21 @@ bool File::begin() {
                 return false;
             }
         }
-        _open();
 
-        // Capture current time to adjust timestamps
-        timestart_ = ftl::time::get_time();
+        if (segment_ == 0) {
+            _open();
+        } else {
+            _openSegment(0);  // Played before, start again from the first segment
+        }
+
+        if (uri_.hasAttribute("speed")) {
+            speed_ = std::max(0.0f, std::stof(uri_.getAttribute<std::string>("speed")));
+        }
+
+        // Capture current time to adjust timestamps, on the frame interval
+        // grid so that files started together have matching timestamps
+        timestart_ = (ftl::time::get_time() / interval_) * interval_;
+        _resetClock(timestart_);
         active_ = true;
         read_error_ = false;
 
@@ -507,20 +1457,36 @@ bool File::begin() {
     } else if (mode_ == Mode::Write) {
         if (!ostream_) ostream_ = new std::ofstream;
         if (!_validateFilename()) return false;
-        ostream_->open(uri_.toFilePath(), std::ifstream::out | std::ifstream::binary);
 
-        if (!ostream_->good()) {
-            DLOG(ERROR) << "Could not open file: '" << uri_.toFilePath() << "'";
-            return false;
+        _configureWrite();
+
+        // Later segments of an earlier segmented recording would be left
+        // behind. Other files are never removed, nor without segment limits.
+        if (segment_size_ > 0 || segment_duration_ > 0) _removeSegments();
+
+        if (!_startSegment(0)) return false;
+
+        index_ = FileIndex();
+        metadata_ = FileMetadata();
+        metadata_channels_.clear();
+        metadata_last_ts_ = 0;
+        write_pos_ = sizeof(ftl::protocol::Header) + sizeof(ftl::protocol::IndexHeader);
+        segment_ends_.clear();
+        front_ends_.clear();
+        back_ends_.clear();
+        block_.clear();
+        block_header_ = ftl::protocol::BlockHeader();
+        last_sync_ = ftl::time::get_time();
+        drop_count_ = 0;
+        write_error_ = false;
+
+        if (write_buffer_size_ > 0) {
+            write_front_.clear();
+            write_back_.clear();
+            writing_ = true;
+            writer_ = std::thread([this]() { _writeThread(); });
         }
 
-        ftl::protocol::Header h;
-        (*ostream_).write((const char*)&h, sizeof(h));
-
-        ftl::protocol::IndexHeader ih;
-        ih.reserved[0] = -1;
-        (*ostream_).write((const char*)&ih, sizeof(ih));
-
         // Capture current time to adjust timestamps
         timestart_ = ftl::time::get_time();
         active_ = true;
@@ -534,11 +1500,25 @@ bool File::end() {
     if (!active_) return false;
     active_ = false;
 
-    if (thread_.joinable()) thread_.join();
+    if (mode_ == Mode::Read) PlaybackScheduler::getInstance().remove(this);
+
+    // A read ahead waits for mutex_, it returns once it sees active_ is false
+    while (reads_ > 0 || finishing_ > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (writer_.joinable()) {
+        {
+            UNIQUE_LOCK(write_mtx_, wlk);
+            writing_ = false;
+        }
+        write_cv_.notify_one();
+        writer_.join();
+    }
 
     UNIQUE_LOCK(mutex_, lk);
 
-    while (jobs_ > 0) {
+    while (jobs_ > 0 || finishing_ > 0) {
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
 
@@ -548,8 +1528,14 @@ bool File::end() {
             delete istream_;
             istream_ = nullptr;
         }
+        map_.reset();
     } else if (mode_ == Mode::Write) {
         if (ostream_) {
+            buffer_out_.clear();
+            if (block_.size() > 0) _packBlock(buffer_out_);
+            _writeBuffer(buffer_out_, segment_ends_);
+            _writeIndex(index_, metadata_, write_pos_);
+            if (sync_policy_ != SyncPolicy::kNone) _sync();
             ostream_->close();
             delete ostream_;
             ostream_ = nullptr;
@@ -581,15 +1567,59 @@ bool File::active() {
 void File::refresh() {}
 
 bool File::enable(FrameID id) {
-    return Stream::enable(id);
+    bool r = Stream::enable(id);
+    _updateFilter();
+    return r;
 }
 
 bool File::enable(FrameID id, ftl::protocol::Channel c) {
-    return Stream::enable(id, c);
+    bool r = Stream::enable(id, c);
+    _updateFilter();
+    return r;
 }
 
 bool File::enable(FrameID id, const ftl::protocol::ChannelSet &channels) {
-    return Stream::enable(id, channels);
+    bool r = Stream::enable(id, channels);
+    _updateFilter();
+    return r;
+}
+
+void File::disable(FrameID id) {
+    Stream::disable(id);
+    _updateFilter();
+}
+
+void File::disable(FrameID id, ftl::protocol::Channel c) {
+    Stream::disable(id, c);
+    _updateFilter();
+}
+
+void File::disable(FrameID id, const ftl::protocol::ChannelSet &channels) {
+    Stream::disable(id, channels);
+    _updateFilter();
+}
+
+void File::_updateFilter() {
+    const auto frames = enabled();
+
+    UNIQUE_LOCK(filter_mtx_, lk);
+    filter_.clear();
+    for (const auto id : frames) {
+        filter_[static_cast<uint32_t>(id)] = enabledChannels(id);
+    }
+    // Frameset packets go with any enabled frame of the frameset
+    for (const auto id : frames) {
+        filter_.try_emplace(static_cast<uint32_t>(FrameID(id.frameset(), 255)));
+    }
+    filtering_ = !frames.empty();
+}
+
+bool File::_isWanted(const StreamPacket &spkt) const {
+    if (!filtering_ || spkt.channel == Channel::kEndFrame) return true;
+
+    auto it = filter_.find(static_cast<uint32_t>(FrameID(spkt.streamID, spkt.frame_number)));
+    if (it == filter_.end()) return false;
+    return it->second.empty() || it->second.count(spkt.channel) > 0;
 }
 
 void File::setProperty(StreamProperty opt, std::any value) {
@@ -597,17 +1627,33 @@ void File::setProperty(StreamProperty opt, std::any value) {
     case StreamProperty::kFrameRate         :
     case StreamProperty::kURI               :   throw FTL_Error("Readonly property");
     case StreamProperty::kLooping           :   looping_ = std::any_cast<bool>(value); break;
-    case StreamProperty::kSpeed             :   speed_ = std::any_cast<int>(value); break;
+    case StreamProperty::kSpeed             :   {
+        if (value.type() == typeid(int)) setSpeed(static_cast<float>(std::any_cast<int>(value)));
+        else if (value.type() == typeid(double)) setSpeed(static_cast<float>(std::any_cast<double>(value)));
+        else
+            setSpeed(std::any_cast<float>(value));
+        break;
+    }
+    case StreamProperty::kDuration          :
+    case StreamProperty::kDropCount         :   throw FTL_Error("Readonly property");
+    case StreamProperty::kPosition          :   {
+        int64_t pos = (value.type() == typeid(int)) ? std::any_cast<int>(value) : std::any_cast<int64_t>(value);
+        if (!seek(pos)) throw FTL_Error("Cannot seek, recording not playing or has no index");
+        break;
+    }
     default                                 :   throw FTL_Error("Property not supported");
     }
 }
 
 std::any File::getProperty(StreamProperty opt) {
     switch (opt) {
-    case StreamProperty::kSpeed             :   return speed_;
+    case StreamProperty::kSpeed             :   return speed_.load();
     case StreamProperty::kFrameRate         :   return framerate_;
     case StreamProperty::kLooping           :   return looping_;
     case StreamProperty::kURI               :   return uri_.getBaseURI();
+    case StreamProperty::kDuration          :   return duration();
+    case StreamProperty::kPosition          :   return position();
+    case StreamProperty::kDropCount         :   return static_cast<int>(drop_count_);
     default                                 :   throw FTL_Error("Property not supported");
     }
 }
@@ -617,6 +1663,9 @@ bool File::supportsProperty(StreamProperty opt) {
     case StreamProperty::kSpeed             :
     case StreamProperty::kFrameRate         :
     case StreamProperty::kLooping           :
+    case StreamProperty::kDuration          :
+    case StreamProperty::kPosition          :
+    case StreamProperty::kDropCount         :
     case StreamProperty::kURI               :   return true;
     default                                 :   return false;
     }
@@ -7,20 +7,37 @@
 #pragma once
 
 #include <string>
-#include <list>
 #include <tuple>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <thread>
+#include <limits>
+#include <atomic>
+#include <condition_variable>
 #include <ftl/protocol/packet.hpp>
 #include <ftl/protocol/streams.hpp>
 #include <ftl/handle.hpp>
 #include <ftl/uri.hpp>
 #include <msgpack.hpp>
+#include "fileindex.hpp"
+#include "mappedfile.hpp"
+#include "packetMsgpack.hpp"
 
 namespace ftl {
 namespace protocol {
 
+/**
+ * Packet read from a file without copying its data. For memory mapped files
+ * the data stays valid while `mapping` is held, otherwise only until the next
+ * read from the file.
+ */
+struct FilePacketView {
+    ftl::protocol::StreamPacket spkt;
+    ftl::protocol::PacketViewMSGPACK pkt;
+    std::shared_ptr<const MappedFile> mapping;
+};
+
 /**
  * Provide a packet stream to/from a file. If the file already exists it is
  * opened readonly, if not it is created write only. A mode to support both
@@ -47,6 +64,9 @@ class File : public Stream {
     bool enable(FrameID id) override;
     bool enable(FrameID id, ftl::protocol::Channel c) override;
     bool enable(FrameID id, const ftl::protocol::ChannelSet &channels) override;
+    void disable(FrameID id) override;
+    void disable(FrameID id, ftl::protocol::Channel c) override;
+    void disable(FrameID id, const ftl::protocol::ChannelSet &channels) override;
 
     void setProperty(ftl::protocol::StreamProperty opt, std::any value) override;
     std::any getProperty(ftl::protocol::StreamProperty opt) override;
@@ -55,7 +75,8 @@ class File : public Stream {
     StreamType type() const override { return StreamType::kRecorded; }
 
     /**
-     * Automatically tick through the frames using a timer. Threads are used.
+     * Automatically tick through the frames using the shared playback
+     * scheduler, see PlaybackScheduler.
      */
     bool run();
 
@@ -70,15 +91,110 @@ class File : public Stream {
      */
     bool readPacket(ftl::protocol::Packet &);
 
+    /**
+     * Read a packet without copying its data, see FilePacketView. Returns
+     * false if no more packets exist.
+     */
+    bool readPacket(FilePacketView &);
+
+    /**
+     * Jump to a position in milliseconds from the start of the recording. The
+     * nearest key frame before the position is used. Requires the stream to
+     * be active and the file to have an index, returns false otherwise.
+     */
+    bool seek(int64_t position);
+
+    /**
+     * Length of the recording in milliseconds, 0 if unknown (no index). Only
+     * the file headers and index are read if the stream is not yet started.
+     */
+    int64_t duration();
+
+    /** Current playback position in milliseconds from start. */
+    int64_t position() const;
+
     enum class Mode {
         Read,
         Write,
         ReadWrite
     };
 
+    /** When data written to a recording is flushed to disk. */
+    enum class SyncPolicy {
+        kNone,      // Left to the operating system
+        kOnClose,   // Once when the recording ends
+        kPeriodic,  // After a write if the sync interval has passed
+        kAlways     // After every write
+    };
+
     inline void setMode(Mode m) { mode_ = m; }
     inline void setStart(int64_t ts) { timestamp_ = ts; }
 
+    /**
+     * Memory map regular files when reading, off by default. Only use it for
+     * files that are not written while being played, see MappedFile. Pipes
+     * and other special files are always read as a stream. Set before `begin`
+     * or use the "mmap" URI attribute.
+     */
+    inline void setMemoryMapped(bool v) { use_mmap_ = v; }
+
+    /**
+     * Playback speed as a multiple of the recorded rate. A speed of 0 plays
+     * frames in order as fast as the packet callbacks return. Also set by the
+     * kSpeed property or "speed" URI attribute.
+     */
+    void setSpeed(float speed);
+    inline float speed() const { return speed_; }
+    inline bool isMemoryMapped() const { return static_cast<bool>(map_); }
+
+    /**
+     * Write packets from a background thread using two buffers of this many
+     * bytes, or write synchronously in `post` if 0 (default). If both buffers
+     * are full the packet is dropped and counted. Set before `begin`, or use
+     * the "writebuffer" URI attribute.
+     */
+    inline void setWriteBuffer(size_t bytes) { write_buffer_size_ = bytes; }
+
+    /**
+     * Set before `begin`, or use the "sync" (none, close, periodic, always)
+     * and "syncinterval" (milliseconds) URI attributes.
+     */
+    inline void setSyncPolicy(SyncPolicy p, int64_t interval = 1000) {
+        sync_policy_ = p;
+        sync_interval_ = interval;
+    }
+
+    /** Number of packets dropped by background writing. */
+    inline size_t dropCount() const { return drop_count_; }
+
+    /**
+     * Packet format version to record, kCurrentFTLVersion by default or
+     * kBlockFTLVersion for checksummed blocks that can be decoded separately.
+     * Set before `begin`, or use the "version" URI attribute.
+     */
+    inline void setFormatVersion(int v) { format_version_ = v; }
+
+    /**
+     * Continue the recording in a new segment file once the current one
+     * reaches this many bytes or milliseconds, 0 for no limit (default).
+     * Segments after the first are named "<name>.<n>.ftl" and each has its
+     * own index, reading the first segment plays all of them. Only files whose
+     * metadata says the recording continues are followed, and only segments
+     * of such an earlier recording are removed by `begin`. Set before
+     * `begin`, or use the "segmentsize" and "segmentduration" URI attributes.
+     */
+    inline void setSegmentLimits(int64_t bytes, int64_t ms) {
+        segment_size_ = bytes;
+        segment_duration_ = ms;
+    }
+
+    /**
+     * Check every block checksum of a version 6 file, in parallel on the
+     * thread pool. Returns the number of damaged blocks, or -1 if the file
+     * cannot be mapped or is an older version.
+     */
+    int verify();
+
     // TODO(Nick): have standalone function to for validating the file
     /// check if valid file/stream
     bool isValid();
@@ -87,13 +203,39 @@ class File : public Stream {
     ftl::URI uri_;
     std::ofstream *ostream_;
     std::ifstream *istream_;
-    std::thread thread_;
 
     bool checked_ = false;
     Mode mode_;
     msgpack::sbuffer buffer_out_;
     msgpack::unpacker buffer_in_;
-    std::list<ftl::protocol::Packet> data_;
+    msgpack::object_handle msg_;                // Last message read from buffer_in_
+    std::shared_ptr<const MappedFile> map_;
+    msgpack::zone zone_;                        // Last message read from map_
+    bool use_mmap_ = false;
+
+    static constexpr size_t kNoPacket = std::numeric_limits<size_t>::max();
+
+    /** Read ahead packet, linked to the next packet of its frame once dispatched. */
+    struct BufferedPacket {
+        ftl::protocol::Packet packet;
+        size_t next = kNoPacket;
+    };
+
+    /** Packets of one frame at one timestamp, and its end frame, handled by one job. */
+    struct FrameBatch {
+        int64_t timestamp;
+        uint8_t streamID;
+        uint8_t frame_number;
+        size_t first = kNoPacket;   // Slot in data_
+        size_t last = kNoPacket;
+        int end_count = -1;         // Packet count of the end frame, -1 if none
+    };
+
+    std::vector<BufferedPacket> data_;  // Ring buffer, slots are reused
+    size_t data_head_ = 0;              // Slot of the oldest packet
+    size_t data_size_ = 0;              // Packets in the buffer
+    size_t data_dispatched_ = 0;        // Oldest packets given to jobs by the last tick
+    std::vector<FrameBatch> batches_;
     int64_t timestart_ = 0;
     int64_t timestamp_ = 0;
     int64_t interval_ = 50;
@@ -104,7 +246,57 @@ class File : public Stream {
     bool read_error_ = false;
     bool looping_ = false;
     int framerate_ = 0;
-    int speed_ = 1;
+    std::atomic<float> speed_ = 1.0f;  // Playback speed multiplier, 0 for unthrottled
+    int64_t clock_base_ = 0;    // Playback time at clock_wall_
+    int64_t clock_wall_ = 0;
+
+    FileIndex index_;
+    bool index_checked_ = false;
+    FileMetadata metadata_;
+    bool has_metadata_ = false;
+    std::unordered_set<uint64_t> metadata_channels_;   // Channels already in metadata_
+    int64_t metadata_last_ts_ = 0;
+    int64_t data_start_ = 0;    // Offset of first packet
+    int64_t data_end_ = -1;     // Offset of the index block, if any
+    int64_t read_pos_ = 0;      // Offset of next byte read from the file
+    int64_t write_pos_ = 0;     // Bytes written to the file
+
+    int format_version_ = ftl::protocol::kCurrentFTLVersion;
+    msgpack::sbuffer block_;                    // Packets of the block being written
+    ftl::protocol::BlockHeader block_header_;
+    std::vector<char> block_buffer_;            // Block read from istream_
+    const char *block_data_ = nullptr;          // Block being read
+    size_t block_size_ = 0;
+    size_t block_pos_ = 0;
+    int64_t file_size_ = 0;
+
+    /** Segment finished by post, closed once written up to `offset` of its buffer. */
+    struct SegmentEnd {
+        size_t offset;
+        int64_t index_offset;
+        FileIndex index;
+        FileMetadata metadata;
+    };
+
+    int64_t segment_size_ = 0;
+    int64_t segment_duration_ = 0;
+    int segment_ = 0;                           // Segment being read or written
+    std::vector<SegmentEnd> segment_ends_;      // Segments ending in buffer_out_
+    std::vector<SegmentEnd> front_ends_;        // Segments ending in write_front_
+    std::vector<SegmentEnd> back_ends_;         // Segments ending in write_back_
+
+    size_t write_buffer_size_ = 0;
+    SyncPolicy sync_policy_ = SyncPolicy::kNone;
+    int64_t sync_interval_ = 1000;
+    int64_t last_sync_ = 0;
+    std::atomic_size_t drop_count_ = 0;
+    std::atomic_bool write_error_ = false;
+    std::thread writer_;
+    bool writing_ = false;
+    MUTEX write_mtx_;
+    std::condition_variable write_cv_;
+    msgpack::sbuffer write_front_;      // Filled by post
+    msgpack::sbuffer write_back_;       // Being written by writer_
 
     struct FramesetData {
         size_t frame_count = 0;
@@ -116,12 +308,64 @@ class File : public Stream {
     };
     std::unordered_map<int, FramesetData> framesets_;
 
+    // Enabled channels of enabled frames, all frames are read if none are enabled
+    std::unordered_map<uint32_t, ftl::protocol::ChannelSet> filter_;
+    bool filtering_ = false;
+    MUTEX filter_mtx_;
+
     MUTEX mutex_;
-    MUTEX data_mutex_;
     std::atomic<int> jobs_ = 0;
+    std::atomic<int> reads_ = 0;    // Read ahead posted by _step
+    std::atomic<int> finishing_ = 0;
 
     bool _open();
+    bool _openMapped();
+    bool _nextObject(msgpack::object &obj);
+    bool _readObject(msgpack::object &obj);
+    bool _nextBlock();
+    int64_t _findBlock(int64_t from, int64_t end);
+    bool _readAt(int64_t offset, char *data, size_t size);
+    void _packPacket(
+        msgpack::sbuffer &out,
+        std::vector<SegmentEnd> &ends,
+        const ftl::protocol::StreamPacket &s,
+        const ftl::protocol::DataPacket &p);
+    void _packBlock(msgpack::sbuffer &out);
+    bool _convertHeader(const msgpack::object &obj, ftl::protocol::StreamPacket &spkt);
+    bool _convertPacket(const msgpack::object &obj, ftl::protocol::Packet &data);
+    void _updateFilter();
+    bool _isWanted(const ftl::protocol::StreamPacket &spkt) const;
     bool _checkFile();
+    void _setTiming(int64_t frames, int64_t interval);
+    bool _readIndex(int64_t offset);
+    void _writeIndex(FileIndex &index, FileMetadata &metadata, int64_t offset);
+    void _writeBuffer(const msgpack::sbuffer &buffer, std::vector<SegmentEnd> &ends);
+    std::string _segmentPath(int n) const;
+    bool _segmentFull(const ftl::protocol::StreamPacket &s) const;
+    void _endSegment(msgpack::sbuffer &out, std::vector<SegmentEnd> &ends);
+    bool _startSegment(int n);
+    bool _openSegment(int n);
+    bool _nextSegment();
+    bool _continues() const;
+    bool _segmentRange(int n, int64_t &first, int64_t &last);
+    int _lastSegment() const;
+    void _removeSegments();
+    void _rewind();
+    void _indexPacket(const ftl::protocol::StreamPacket &s, const ftl::protocol::DataPacket &p);
+    void _writeThread();
+    void _configureWrite();
+    void _sync();
+    void _seekOffset(int64_t offset);
+    int64_t _playbackTime(int64_t now) const;
+    int64_t _step(int64_t now);
+    void _releaseFrames(int64_t ts);
+    bool _readAhead();
+    void _jobDone(ftl::Counter &&job, bool progress);
+    void _resetClock(int64_t now);
+    ftl::protocol::Packet *_pushPacket();
+    void _popPackets(size_t n);
+    FrameBatch &_getBatch(int64_t ts, uint8_t sid, uint8_t frame);
+    void _dispatch(const FrameBatch &batch);
     bool _validateFilename() const;
 
     /* Apply version patches etc... */
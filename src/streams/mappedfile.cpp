@@ -0,0 +1,110 @@
+/**
+ * @file mappedfile.cpp
+ * @copyright Copyright (c) 2022 University of Turku, MIT License
+ */
+
+#include <filesystem>
+#include "mappedfile.hpp"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using ftl::protocol::MappedFile;
+
+#ifdef WIN32
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string &path) {
+    std::filesystem::path p = std::filesystem::u8path(path);
+
+    HANDLE file = CreateFileW(p.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+    LARGE_INTEGER size;
+    if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    std::shared_ptr<MappedFile> f(new MappedFile());
+    f->data_ = static_cast<const uint8_t*>(data);
+    f->size_ = static_cast<size_t>(size.QuadPart);
+    f->file_ = file;
+    f->mapping_ = mapping;
+    return f;
+}
+
+MappedFile::~MappedFile() {
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_) CloseHandle(file_);
+}
+
+bool ftl::protocol::syncFile(const std::string &path) {
+    std::filesystem::path p = std::filesystem::u8path(path);
+    HANDLE file = CreateFileW(p.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    bool result = FlushFileBuffers(file);
+    CloseHandle(file);
+    return result;
+}
+
+#else
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // Mapping stays valid
+    if (data == MAP_FAILED) return nullptr;
+
+    // Recordings are mostly played from start to end
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    std::shared_ptr<MappedFile> f(new MappedFile());
+    f->data_ = static_cast<const uint8_t*>(data);
+    f->size_ = static_cast<size_t>(st.st_size);
+    return f;
+}
+
+MappedFile::~MappedFile() {
+    if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+bool ftl::protocol::syncFile(const std::string &path) {
+    // fsync applies to the file, not only to data written through this fd
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool result = fsync(fd) == 0;
+    ::close(fd);
+    return result;
+}
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * @file mappedfile.hpp
+ * @copyright Copyright (c) 2022 University of Turku, MIT License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace ftl {
+namespace protocol {
+
+/**
+ * Read only memory mapping of a whole regular file. Data pointers into the
+ * mapping remain valid for as long as the MappedFile exists, so share it with
+ * anything holding such pointers.
+ *
+ * The file must not be truncated or overwritten while it is mapped. On POSIX
+ * systems reading a page past the new end raises SIGBUS and kills the
+ * process, where a stream read would just see the end of the file.
+ */
+class MappedFile {
+ public:
+    /**
+     * Map a file. Returns nullptr if the file cannot be mapped, for example
+     * if it is a pipe, a special file or is empty.
+     */
+    static std::shared_ptr<MappedFile> open(const std::string &path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    inline const uint8_t *data() const { return data_; }
+    inline size_t size() const { return size_; }
+
+ private:
+    MappedFile() = default;
+
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+
+    #ifdef WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+    #endif
+};
+
+/**
+ * Flush file data written through any handle to the storage device (fsync).
+ * Returns false if the file could not be opened or synced.
+ */
+bool syncFile(const std::string &path);
+
+}  // namespace protocol
+}  // namespace ftl
@@ -4,6 +4,7 @@
  * @author Nicolas Pope
  */
 
+#include <algorithm>
 #include <ftl/protocol/muxer.hpp>
 #include <ftl/lib/loguru.hpp>
 #include <ftl/uri.hpp>
@@ -26,73 +27,104 @@ Muxer::~Muxer() {
     }
 }
 
+template <typename T>
+void Muxer::_publish(
+        std::atomic<const FrameTable<T>*> &table,
+        std::shared_ptr<const FrameTable<T>> &owner,
+        FrameID id,
+        const T &value) {
+    if (id.frameset() >= 256) throw FTL_Error("Frameset out of range: " << id.frameset());
+
+    auto next = (owner) ? std::make_shared<FrameTable<T>>(*owner) : std::make_shared<FrameTable<T>>();
+
+    // Only the changed row is copied, others are shared with the old table
+    const auto &row = next->framesets[id.frameset()];
+    auto newrow = (row) ? std::make_shared<std::array<T, 256>>(*row) : std::make_shared<std::array<T, 256>>();
+    (*newrow)[id.source()] = value;
+    next->framesets[id.frameset()] = newrow;
+
+    table.store(next.get());
+    std::shared_ptr<const void> old = std::move(owner);
+    owner = std::move(next);
+    _retire(std::move(old));
+}
+
+void Muxer::_retire(std::shared_ptr<const void> &&old) {
+    if (old) retired_.push_back(std::move(old));
+}
+
 FrameID Muxer::_mapFromInput(Muxer::StreamEntry *s, FrameID id) {
-    SHARED_LOCK(mutex_, lk);
-    int64_t iid = (int64_t(s->id) << 32) | id.id;
-    auto it = imap_.find(iid);
-    if (it != imap_.end()) {
-        return it->second;
+    const auto *table = s->imap.load();
+    const auto *mapping = (table) ? table->find(id) : nullptr;
+    if (mapping && mapping->valid) return mapping->local;
+
+    // Otherwise allocate something.
+    UNIQUE_LOCK(mutex_, lk);
+    table = s->imap_owner.get();
+    mapping = (table) ? table->find(id) : nullptr;
+    if (mapping && mapping->valid) return mapping->local;
+
+    FrameID newID;
+    if (s->fixed_fs >= 0) {
+        int source = sourcecount_[s->fixed_fs]++;
+        if (source >= 255) throw FTL_Error("Too many frames in frameset " << s->fixed_fs);
+        newID = FrameID(s->fixed_fs, source);
+        if (newID.frameset() >= kMaxStreams) throw FTL_Error("Too many framesets in muxer");
     } else {
-        // Otherwise allocate something.
-        lk.unlock();
-        UNIQUE_LOCK(mutex_, ulk);
-        auto it2 = imap_.find(iid);
-        if (it2 != imap_.end()) {
-            return it2->second;
+        int fsiid = (s->id << 16) | id.frameset();
+        auto fit = fsmap_.find(fsiid);
+        if (fit != fsmap_.end()) {
+            newID = FrameID(fit->second, id.source());
+        } else if (!free_framesets_.empty()) {
+            newID = FrameID(*free_framesets_.begin(), id.source());
+            free_framesets_.erase(free_framesets_.begin());
+            fsmap_[fsiid] = newID.frameset();
         } else {
-            FrameID newID;
-            if (s->fixed_fs >= 0) {
-                int source = sourcecount_[s->fixed_fs]++;
-                newID = FrameID(s->fixed_fs, source);
-            } else {
-                int fsiid = (s->id << 16) | id.frameset();
-                if (fsmap_.count(fsiid) == 0) fsmap_[fsiid] = framesets_++;
-                newID = FrameID(fsmap_[fsiid], id.source());
-            }
-
-            imap_[iid] = newID;
-            auto &op = omap_[newID];
-            op.first = id;
-            op.second = s;
-            return newID;
+            if (static_cast<size_t>(framesets_) >= kMaxStreams) throw FTL_Error("Too many framesets in muxer");
+            newID = FrameID(framesets_++, id.source());
+            fsmap_[fsiid] = newID.frameset();
         }
     }
+
+    // Output first, so any local ID seen can be mapped back
+    _publish(omap_, omap_owner_, newID, OutputMapping{id, s});
+    _publish(s->imap, s->imap_owner, id, InputMapping{newID, true});
+    return newID;
 }
 
 FrameID Muxer::_mapFromInput(const Muxer::StreamEntry *s, FrameID id) const {
-    SHARED_LOCK(mutex_, lk);
-    int64_t iid = (int64_t(s->id) << 32) | id.id;
-    auto it = imap_.find(iid);
-    if (it != imap_.end()) {
-        return it->second;
+    const auto *table = s->imap.load();
+    const auto *mapping = (table) ? table->find(id) : nullptr;
+    if (mapping && mapping->valid) {
+        return mapping->local;
     } else {
         throw FTL_Error("No mapping");
     }
 }
 
 std::pair<FrameID, Muxer::StreamEntry*> Muxer::_mapToOutput(FrameID id) const {
-    SHARED_LOCK(mutex_, lk);
-    auto it = omap_.find(id);
-    if (it != omap_.end()) {
-        return it->second;
+    const auto *table = omap_.load();
+    const auto *mapping = (table) ? table->find(id) : nullptr;
+    if (mapping && mapping->entry) {
+        return {mapping->remote, mapping->entry};
     } else {
         return {id, nullptr};
     }
 }
 
-std::shared_ptr<Stream> Muxer::findStream(const std::string &uri) const {
+const Muxer::StreamEntry *Muxer::_findEntry(const std::string &uri) const {
     SHARED_LOCK(mutex_, lk);
-    for (const auto &e : streams_) {
-        if (std::any_cast<std::string>(e.stream->getProperty(StreamProperty::kURI)) == uri) {
-            return e.stream;
-        }
-    }
-    return nullptr;
+    auto it = uris_.find(uri);
+    return (it != uris_.end()) ? it->second : nullptr;
+}
+
+std::shared_ptr<Stream> Muxer::findStream(const std::string &uri) const {
+    const StreamEntry *entry = _findEntry(uri);
+    return (entry) ? entry->stream : nullptr;
 }
 
 FrameID Muxer::findLocal(const std::string &uri) const {
     ftl::URI u(uri);
-    const StreamEntry *entry = nullptr;
 
     int fsid = 0;
     int fid = 0;
@@ -104,16 +136,7 @@ FrameID Muxer::findLocal(const std::string &uri) const {
     }
     FrameID remote(fsid, fid);
 
-    {
-        SHARED_LOCK(mutex_, lk);
-        for (const auto &e : streams_) {
-            if (std::any_cast<std::string>(e.stream->getProperty(StreamProperty::kURI)) == uri) {
-                entry = &e;
-                break;
-            }
-        }
-    }
-
+    const StreamEntry *entry = _findEntry(uri);
     if (entry) {
         return _mapFromInput(entry, remote);
     } else {
@@ -122,18 +145,7 @@ FrameID Muxer::findLocal(const std::string &uri) const {
 }
 
 FrameID Muxer::findLocal(const std::string &uri, FrameID remote) const {
-    const StreamEntry *entry = nullptr;
-
-    {
-        SHARED_LOCK(mutex_, lk);
-        for (const auto &e : streams_) {
-            if (std::any_cast<std::string>(e.stream->getProperty(StreamProperty::kURI)) == uri) {
-                entry = &e;
-                break;
-            }
-        }
-    } 
-
+    const StreamEntry *entry = _findEntry(uri);
     if (entry) {
         return _mapFromInput(entry, remote);
     } else {
@@ -210,10 +222,24 @@ void Muxer::add(const std::shared_ptr<Stream> &s, int fsid) {
     se.stream = s;
     se.fixed_fs = fsid;
 
+    // URI is read once here, instead of for every lookup
+    try {
+        se.uri = std::any_cast<std::string>(s->getProperty(StreamProperty::kURI));
+    } catch (const std::exception &e) {
+        se.uri.clear();
+    }
+    if (!se.uri.empty()) uris_.emplace(se.uri, &se);
+
     Muxer::StreamEntry *ptr = &se;
 
     se.handle = std::move(s->onPacket([this, ptr](const StreamPacket &spkt, const DataPacket &pkt) {
-        FrameID newID = _mapFromInput(ptr, FrameID(spkt.streamID, spkt.frame_number));
+        const FrameID id(spkt.streamID, spkt.frame_number);
+        FrameID newID = _mapFromInput(ptr, id);
+
+        if (newID == id) {
+            trigger(spkt, pkt);
+            return true;
+        }
 
         StreamPacket spkt2 = spkt;
         spkt2.streamID = newID.frameset();
@@ -266,20 +292,50 @@ void Muxer::remove(const std::shared_ptr<Stream> &s) {
             se->req_handle.cancel();
             se->avail_handle.cancel();
 
-            // Cleanup imap and omap
-            for (auto j = imap_.begin(); j != imap_.end();) {
-                const auto &e = *j;
-                if (e.first >> 32 == se->id) j = imap_.erase(j);
-                else
-                    ++j;
+            // Cleanup omap, the imap goes with the entry
+            if (omap_owner_) {
+                auto next = std::make_shared<OutputTable>(*omap_owner_);
+                for (auto &row : next->framesets) {
+                    if (!row) continue;
+                    auto uses = [se](const OutputMapping &m) { return m.entry == se; };
+                    if (std::none_of(row->begin(), row->end(), uses)) continue;
+
+                    auto newrow = std::make_shared<std::array<OutputMapping, 256>>(*row);
+                    for (auto &m : *newrow) {
+                        if (uses(m)) m = OutputMapping();
+                    }
+                    row = newrow;
+                }
+                omap_.store(next.get());
+                std::shared_ptr<const void> old = std::move(omap_owner_);
+                omap_owner_ = std::move(next);
+                _retire(std::move(old));
+            }
+
+            // Framesets that were allocated to this stream can be used again
+            for (auto fit = fsmap_.begin(); fit != fsmap_.end();) {
+                if ((fit->first >> 16) == se->id) {
+                    free_framesets_.insert(fit->second);
+                    fit = fsmap_.erase(fit);
+                } else {
+                    ++fit;
+                }
             }
-            for (auto j = omap_.begin(); j != omap_.end();) {
-                const auto &e = *j;
-                if (e.second.second == se) j = omap_.erase(j);
-                else
-                    ++j;
+
+            // Another stream with the same URI can now be found
+            auto uit = uris_.find(se->uri);
+            if (uit != uris_.end() && uit->second == se) {
+                uris_.erase(uit);
+                for (auto &e : streams_) {
+                    if (&e != se && e.uri == se->uri) {
+                        uris_.emplace(e.uri, &e);
+                        break;
+                    }
+                }
             }
 
+            se->imap = nullptr;
+            _retire(std::move(se->imap_owner));
             streams_.erase(i);
             return;
         }
@@ -292,8 +348,11 @@ std::shared_ptr<Stream> Muxer::originStream(FrameID id) const {
 }
 
 bool Muxer::post(const StreamPacket &spkt, const DataPacket &pkt) {
-    auto p = _mapToOutput(FrameID(spkt.streamID, spkt.frame_number));
+    const FrameID id(spkt.streamID, spkt.frame_number);
+    auto p = _mapToOutput(id);
     if (!p.second) return false;
+    if (p.first == id) return p.second->stream->post(spkt, pkt);
+
     StreamPacket spkt2 = spkt;
     spkt2.streamID = p.first.frameset();
     spkt2.frame_number = p.first.source();
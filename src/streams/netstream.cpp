@@ -11,6 +11,8 @@
 #include <algorithm>
 #include <thread>
 #include <chrono>
+#include <array>
+#include <optional>
 #include "netstream.hpp"
 #include <ftl/time.hpp>
 #include <ftl/counter.hpp>
@@ -33,6 +35,7 @@ using ftl::protocol::Net;
 using ftl::protocol::NetStats;
 using ftl::protocol::StreamPacket;
 using ftl::protocol::PacketMSGPACK;
+using ftl::protocol::PacketHeaderMSGPACK;
 using ftl::protocol::StreamPacketMSGPACK;
 using ftl::protocol::DataPacket;
 using ftl::protocol::Channel;
@@ -51,6 +54,9 @@ std::atomic_size_t Net::req_bitrate__ = 0;
 std::atomic_size_t Net::tx_bitrate__ = 0;
 std::atomic_size_t Net::rx_sample_count__ = 0;
 std::atomic_size_t Net::tx_sample_count__ = 0;
+std::atomic_int64_t Net::encode_time__ = 0;
+std::atomic_size_t Net::encode_count__ = 0;
+std::atomic_size_t Net::encodes__ = 0;
 int64_t Net::last_msg__ = 0;
 MUTEX Net::msg_mtx__;
 
@@ -164,14 +170,35 @@ int Net::postQueueSize(FrameID frame_id, Channel channel) const {
     return 0;
 }
 
-bool Net::net_send_(ftl::net::PeerBase* peer, const std::string &name, int16_t ttimeoff, const ftl::protocol::StreamPacket& spkt, const ftl::protocol::DataPacket& dpkt) {
+// Only the packet header is serialised, payload bytes are written directly
+// from the DataPacket without copying.
+static int sendPacket(ftl::net::PeerBase* peer, ftl::net::SendFlags flags, const std::string &name, int16_t ttimeoff,
+        const StreamPacket& spkt, const DataPacket& dpkt) {
+    if (dpkt.data.empty()) {
+        return peer->send(flags, name, ttimeoff,
+            reinterpret_cast<const StreamPacketMSGPACK&>(spkt), reinterpret_cast<const PacketMSGPACK&>(dpkt));
+    }
+    return peer->sendWithPayload(flags, dpkt.data.data(), dpkt.data.size(), name, ttimeoff,
+        reinterpret_cast<const StreamPacketMSGPACK&>(spkt), reinterpret_cast<const PacketHeaderMSGPACK&>(dpkt));
+}
+
+bool Net::net_send_(ftl::net::PeerBase* peer, const std::string &name, int16_t ttimeoff, const ftl::protocol::StreamPacket& spkt, const ftl::protocol::DataPacket& dpkt, ftl::net::SendFlags flags) {
     DEBUG_CHECK_PKT(dbg_mtx_send_, dbg_send_, spkt, "send");
-    return peer->send(name, ttimeoff, reinterpret_cast<const StreamPacketMSGPACK&>(spkt), reinterpret_cast<const PacketMSGPACK&>(dpkt));
+    // kSendWouldBlock: packet dropped as peer is not keeping up, but client remains valid
+    return sendPacket(peer, flags, name, ttimeoff, spkt, dpkt) >= 0;
+}
+
+bool Net::net_send_(ftl::net::PeerBase* peer, const std::string &name, const ftl::protocol::StreamPacket& spkt, const ftl::net::PeerBase::shared_buffer_t &encoded, ftl::net::SendFlags flags) {
+    DEBUG_CHECK_PKT(dbg_mtx_send_, dbg_send_, spkt, "send");
+    return peer->sendEncoded(flags, name, encoded) >= 0;
 }
 
 bool Net::net_send_(const ftl::UUID &pid, const std::string &name, int16_t ttimeoff, const ftl::protocol::StreamPacket& spkt, const ftl::protocol::DataPacket& dpkt) {
     DEBUG_CHECK_PKT(dbg_mtx_send_, dbg_send_, spkt, "send");
-    return net_->send(pid, name, ttimeoff, reinterpret_cast<const StreamPacketMSGPACK&>(spkt), reinterpret_cast<const PacketMSGPACK&>(dpkt));
+    // Universe::send() would copy the arguments
+    auto peer = net_->getPeer(pid);
+    if (!peer || !peer->isConnected()) return false;
+    return sendPacket(peer.get(), ftl::net::SendFlags::NONE, name, ttimeoff, spkt, dpkt) >= 0;
 }
 
 bool Net::send(const StreamPacket &spkt, const DataPacket &pkt) {
@@ -198,6 +225,20 @@ bool Net::send(const StreamPacket &spkt, const DataPacket &pkt) {
         // If this particular frame has clients then loop over them
         if (clients_local_.count(frameId) > 0) {
             auto &clients = clients_local_.at(frameId);
+            const int16_t pre_transmit_latency = int16_t(ftl::time::get_time() - spkt.localTimestamp);
+
+            // With several clients each packet is serialised once per variant
+            // (stripped or not, method name or the id a client has given) and
+            // the same buffer is sent to all clients of that variant. A single
+            // client is sent the payload without copying it at all.
+            const bool broadcast = clients.size() > 1;
+            struct Encoded {
+                bool strip;
+                std::optional<uint32_t> id;
+                ftl::net::PeerBase::shared_buffer_t buffer;
+            };
+            std::array<Encoded, 4> encoded;
+            size_t encoded_count = 0;
 
             for (auto &client : clients) {
                 // Strip packet data if channel is not wanted by client
@@ -205,19 +246,51 @@ bool Net::send(const StreamPacket &spkt, const DataPacket &pkt) {
                     static_cast<int>(spkt.channel) < 32 && pkt.data.size() > 0          // is a video channel?
                     && ((1 << static_cast<int>(spkt.channel)) & client.channels) == 0;  // not included in bitmask?
 
-                try {
-                    int16_t pre_transmit_latency = int16_t(ftl::time::get_time() - spkt.localTimestamp);
+                // Small packets are written together, end of frame flushes
+                const auto flags =
+                    (spkt.channel != Channel::kEndFrame && (strip || pkt.data.size() <= kCoalescePacketSize))
+                    ? ftl::net::SendFlags::DELAY : ftl::net::SendFlags::NONE;
 
-                    // TODO(Nick): msgpack only once and broadcast.
+                try {
                     auto peer = net_->getPeer(client.peerid);
-                    
-                    // Send with QUIC should be non-blocking (assuming there are send buffers available)
-                    if (!peer || !net_send_(
+                    bool sent = false;
+
+                    if (peer && broadcast) {
+                        const auto id = peer->remoteMethodId(base_uri_);
+                        auto variant = std::find_if(encoded.begin(), encoded.begin() + encoded_count,
+                            [strip, &id](const Encoded &e) { return e.strip == strip && e.id == id; });
+
+                        ftl::net::PeerBase::shared_buffer_t buffer;
+                        if (variant != encoded.begin() + encoded_count) {
+                            buffer = variant->buffer;
+                        } else {
+                            const int64_t t_start = ftl::time::get_time_micro();
+                            buffer = ftl::net::PeerBase::encode(
+                                id,
+                                base_uri_,
+                                pre_transmit_latency,  // Time since timestamp for tx
+                                spkt_net,
+                                (strip) ? pkt_strip : reinterpret_cast<const PacketMSGPACK&>(pkt));
+                            encode_time__ += ftl::time::get_time_micro() - t_start;
+                            ++encodes__;
+                            // Further variants are rare, those are encoded per client
+                            if (encoded_count < encoded.size()) encoded[encoded_count++] = {strip, id, buffer};
+                        }
+                        ++encode_count__;
+                        sent = net_send_(peer.get(), base_uri_, spkt, buffer, flags);
+
+                    } else if (peer) {
+                        // Send with QUIC should be non-blocking (assuming there are send buffers available)
+                        sent = net_send_(
                             peer.get(),
                             base_uri_,
                             pre_transmit_latency,  // Time since timestamp for tx
                             spkt_net,
-                            (strip) ? pkt_strip : reinterpret_cast<const PacketMSGPACK&>(pkt))) {
+                            (strip) ? pkt_strip : reinterpret_cast<const PacketMSGPACK&>(pkt),
+                            flags);
+                    }
+
+                    if (!sent) {
                         // Send failed so mark as client stream completed
                         client.txcount = 0;
                     } else {
@@ -270,8 +343,6 @@ bool Net::post(const StreamPacket &spkt, const DataPacket &pkt) {
 }
 
 void Net::_earlyProcessPacket(ftl::net::PeerBase *p, int16_t ttimeoff, const StreamPacket &spkt, DataPacket &pkt) {
-    // Better to crash here than crash later because of out-of-bounds write. StreamID 255 means "all streams".
-    CHECK(spkt.streamID < 5 || spkt.streamID == 255) << "FIXME: Frameset ID must be less than 5 or 255 (tally_[] is a fixed size array)";
     DEBUG_CHECK_PKT(dbg_mtx_recv_, dbg_recv_, spkt, "recv");
 
     if (!active_) return;
@@ -944,12 +1015,18 @@ NetStats Net::getStatistics() {
     UNIQUE_LOCK(msg_mtx__, lk);
     const float r = (static_cast<float>(req_bitrate__) / static_cast<float>(ts - last_msg__) * 1000.0f / 1048576.0f);
     const float t = (static_cast<float>(tx_bitrate__) / static_cast<float>(ts - last_msg__) * 1000.0f / 1048576.0f);
+    const size_t n = encode_count__;
+    const float e = (n > 0) ? static_cast<float>(encode_time__) / static_cast<float>(n) : 0.0f;
+    const size_t encodes = encodes__;
     last_msg__ = ts;
+    encode_time__ = 0;
+    encode_count__ = 0;
+    encodes__ = 0;
     req_bitrate__ = 0;
     tx_bitrate__ = 0;
     rx_sample_count__ = 0;
     tx_sample_count__ = 0;
-    return {r, t};
+    return {r, t, e, encodes};
 }
 
 bool Net::end() {
@@ -37,6 +37,8 @@ struct StreamClientLocal {
 struct NetStats {
     float rxRate;
     float txRate;
+    float encodeCost;   // Serialisation time per client of broadcast packets (microseconds)
+    size_t encodes;     // Broadcast packets serialised, at most once per strip variant
 };
 
 /**
@@ -93,6 +95,9 @@ class Net : public Stream {
 
     static constexpr int kFramesToRequest = 80;
 
+    /** Packets up to this size (bytes) are coalesced until frame end. */
+    static constexpr size_t kCoalescePacketSize = 16*1024;
+
     // Unit test support
     virtual void hasPosted(const ftl::protocol::StreamPacket &, const ftl::protocol::DataPacket &) {}
     void inject(const ftl::protocol::StreamPacket &, ftl::protocol::DataPacket &);
@@ -126,7 +131,8 @@ class Net : public Stream {
     #endif
     
     bool net_send_(const ftl::UUID &pid, const std::string &name, int16_t ttimeoff, const ftl::protocol::StreamPacket&, const ftl::protocol::DataPacket&);
-    bool net_send_(ftl::net::PeerBase* peer, const std::string &name, int16_t ttimeoff, const ftl::protocol::StreamPacket&, const ftl::protocol::DataPacket&);
+    bool net_send_(ftl::net::PeerBase* peer, const std::string &name, int16_t ttimeoff, const ftl::protocol::StreamPacket&, const ftl::protocol::DataPacket&, ftl::net::SendFlags flags = ftl::net::SendFlags::NONE);
+    bool net_send_(ftl::net::PeerBase* peer, const std::string &name, const ftl::protocol::StreamPacket&, const ftl::net::PeerBase::shared_buffer_t &encoded, ftl::net::SendFlags flags);
 
     SHARED_MUTEX mutex_;
     bool active_ = false;
@@ -136,7 +142,7 @@ class Net : public Stream {
     std::string uri_;
     std::string base_uri_;
     const bool host_;
-    std::array<std::atomic_int, 5> tally_ = {};
+    std::array<std::atomic_int, 256> tally_ = {};   // Frames left of the last request, per frameset
     uint8_t bitrate_ = 255;
     std::atomic_int64_t bytes_received_ = 0;
     bool paused_ = false;
@@ -149,6 +155,9 @@ class Net : public Stream {
     static std::atomic_size_t tx_bitrate__;
     static std::atomic_size_t rx_sample_count__;
     static std::atomic_size_t tx_sample_count__;
+    static std::atomic_int64_t encode_time__;       // Microseconds spent encoding broadcast packets
+    static std::atomic_size_t encode_count__;       // Client sends of those packets
+    static std::atomic_size_t encodes__;            // Broadcast packets serialised
     static int64_t last_msg__;
     static MUTEX msg_mtx__;
 
@@ -8,6 +8,7 @@
 
 #include <ftl/protocol/packet.hpp>
 #include <msgpack.hpp>
+#include "../byteView.hpp"
 
 MSGPACK_ADD_ENUM(ftl::protocol::Codec);
 MSGPACK_ADD_ENUM(ftl::protocol::Channel);
@@ -23,6 +24,39 @@ struct PacketMSGPACK : ftl::protocol::DataPacket {
     MSGPACK_DEFINE(codec, reserved, frame_count, bitrate, dataFlags, data);
 };
 
+/**
+ * Packs as PacketMSGPACK but without the bytes of data, only the bin header
+ * for them. Encoded data must be appended directly after, so this must be the
+ * last value packed in a message (see PeerBase::sendWithPayload).
+ */
+struct PacketHeaderMSGPACK : ftl::protocol::DataPacket {
+    template <typename Packer>
+    void msgpack_pack(Packer &pk) const {
+        pk.pack_array(6);
+        pk.pack(codec);
+        pk.pack(reserved);
+        pk.pack(frame_count);
+        pk.pack(bitrate);
+        pk.pack(dataFlags);
+        pk.pack_bin(static_cast<uint32_t>(data.size()));
+    }
+};
+
+/**
+ * Received DataPacket with data borrowed from the message buffer, valid only
+ * during the RPC handler call. Unpacks without copying the payload.
+ */
+struct PacketViewMSGPACK {
+    ftl::protocol::Codec codec = ftl::protocol::Codec::kInvalid;
+    uint8_t reserved = 0;
+    uint8_t frame_count = 1;
+    uint8_t bitrate = 0;
+    uint8_t dataFlags = 0;
+    ftl::net::ByteView data;
+
+    MSGPACK_DEFINE(codec, reserved, frame_count, bitrate, dataFlags, data);
+};
+
 class StreamPacker {
  public:
     explicit StreamPacker(StreamPacket *p) : packet(p) {}
@@ -67,8 +101,20 @@ class Packer {
     DataPacker dpack_;
 };
 
+/** Unpacks a packet with its data borrowed, see PacketViewMSGPACK. */
+class ViewPacker {
+ public:
+    ViewPacker(StreamPacket *s, PacketViewMSGPACK *v) : spack_(s), view_(v) {}
+
+    MSGPACK_DEFINE_ARRAY(spack_, *view_);
+ private:
+    StreamPacker spack_;
+    PacketViewMSGPACK *view_;
+};
+
 static_assert(sizeof(StreamPacketMSGPACK) == sizeof(StreamPacket));
 static_assert(sizeof(PacketMSGPACK) == sizeof(DataPacket));
+static_assert(sizeof(PacketHeaderMSGPACK) == sizeof(DataPacket));
 
 }  // namespace protocol
 }  // namespace ftl
@@ -5,19 +5,36 @@
  */
 
 #include <utility>
-#include <vector>
 #include <limits>
+#include <algorithm>
 #include "packetmanager.hpp"
 #include <ftl/protocol/frameid.hpp>
+#include <ftl/exception.hpp>
 
 #include <loguru.hpp>
 
 using ftl::PacketManager;
 using ftl::StreamState;
+using ftl::ReorderPolicy;
 using ftl::protocol::PacketPair;
 using ftl::protocol::FrameID;
 using ftl::protocol::Channel;
 
+PacketManager::PacketManager(size_t window, int frames, ReorderPolicy policy) : policy_(policy) {
+    setWindow(window, frames);
+}
+
+void PacketManager::setWindow(size_t packets, int frames) {
+    if (packets == 0) throw FTL_Error("Reorder window must hold at least one packet");
+    window_ = packets;
+    max_frames_ = frames;
+}
+
+void PacketManager::reset() {
+    UNIQUE_LOCK(mtx_, lk);
+    state_.clear();
+}
+
 StreamState &PacketManager::getState(FrameID id) {
     {
         SHARED_LOCK(mtx_, lk);
@@ -25,115 +42,140 @@ StreamState &PacketManager::getState(FrameID id) {
         if (it != state_.end()) return it->second;
     }
     UNIQUE_LOCK(mtx_, lk);
-    return state_[id.id];
+    auto &state = state_[id.id];
+    if (state.buffer.empty()) state.buffer.resize(window_);
+    return state;
 }
 
-void PacketManager::submit(PacketPair &packets, const std::function<void(const PacketPair &)> &cb, bool noLoop) {
-    auto &state = getState(FrameID(packets.first.frameSetID(), packets.first.frameNumber()));
+void PacketManager::_nextFrame(StreamState &state) {
+    state.processed = 0;
+    state.expected = -1;
+    state.droppedEndFrames = 0;
 
-    if (state.timestamp == packets.first.timestamp) {
-        if (packets.first.channel == Channel::kEndFrame) {
-            state.expected = packets.second.packet_count;
-        }
-        cb(packets);
-        ++state.processed;
-
-        if (state.processed == state.expected) {
-            UNIQUE_LOCK(state.mtx, lk);
-            if (state.processed == state.expected) {
-                state.processed = 0;
-                state.expected = -1;
-
-                if (state.writePos > state.readPos) {
-                    size_t start = state.readPos;
-                    size_t stop = state.writePos;
-                    state.readPos = stop;
-
-                    int64_t ts = std::numeric_limits<int64_t>::max();
-                    for (size_t i = start; i < stop; ++i) {
-                        ts = std::min(
-                            ts,
-                            state.buffer[i % StreamState::kMaxBuffer].first.timestamp);
-                    }
-
-                    state.timestamp = ts;
-
-                    lk.unlock();
-                    // Loop over the buffer, checking for anything that can be processed
-                    for (size_t i = start; i < stop; ++i) {
-                        if (state.buffer[i % StreamState::kMaxBuffer].first.channel == Channel::kEndFrame) {
-                            --state.bufferedEndFrames;
-                        }
-                        submit(state.buffer[i % StreamState::kMaxBuffer], cb, true);
-                    }
-                } else {
-                    state.timestamp = -1;
-                    return;
+    if (state.count == 0) {
+        state.timestamp = -1;
+        return;
+    }
+
+    int64_t ts = std::numeric_limits<int64_t>::max();
+    for (size_t i = 0; i < state.count; ++i) {
+        ts = std::min(ts, state.buffer[(state.head + i) % state.buffer.size()].first.timestamp);
+    }
+    state.timestamp = ts;
+}
+
+void PacketManager::_skipFrame(StreamState &state) {
+    ++drops_;
+    _nextFrame(state);
+    state.rescan = true;
+}
+
+void PacketManager::_release(
+        StreamState &state,
+        std::unique_lock<MUTEX> &lk,
+        const std::function<void(const PacketPair &)> &cb) {
+    // Only one thread releases buffered packets, it picks up any frames
+    // completed by other threads while it is in the callback.
+    if (state.releasing) return;
+    state.releasing = true;
+
+    while (state.rescan || state.processed == state.expected) {
+        if (!state.rescan) _nextFrame(state);
+        state.rescan = false;
+
+        const size_t size = state.buffer.size();
+        for (size_t n = state.count; n > 0 && state.count > 0; --n) {
+            PacketPair &front = state.buffer[state.head];
+            state.head = (state.head + 1) % size;
+            --state.count;
+
+            // Not in this frame, so rotate it to the back of the ring
+            if (front.first.timestamp > state.timestamp) {
+                PacketPair &back = state.buffer[(state.head + state.count) % size];
+                if (&back != &front) back = std::move(front);
+                ++state.count;
+                continue;
+            }
+
+            PacketPair packets = std::move(front);
+            if (packets.first.channel == Channel::kEndFrame) {
+                --state.bufferedEndFrames;
+                if (packets.first.timestamp == state.timestamp) {
+                    state.expected = packets.second.packet_count;
                 }
             }
-        }
-    } else if (state.timestamp > packets.first.timestamp) {
-        DLOG(WARNING) << "Old packet received";
-        // Note: not ideal but still better than discarding
-        cb(packets);
-        return;
-    } else {
-        DLOG(WARNING) << "Buffer packets: " << packets.first.timestamp;
-        // Change the current frame
-        UNIQUE_LOCK(state.mtx, lk);
-        if (state.timestamp == packets.first.timestamp) {
+
             lk.unlock();
-            submit(packets, cb);
-            return;
+            cb(packets);
+            lk.lock();
+
+            if (packets.first.timestamp == state.timestamp) ++state.processed;
+            if (state.rescan || state.processed == state.expected) break;
         }
+    }
 
-        if (state.timestamp == -1) {
-            state.timestamp = packets.first.timestamp;
-            lk.unlock();
-            submit(packets, cb);
+    state.releasing = false;
+}
+
+void PacketManager::submit(PacketPair &packets, const std::function<void(const PacketPair &)> &cb) {
+    auto &state = getState(FrameID(packets.first.frameSetID(), packets.first.frameNumber()));
+    const int64_t ts = packets.first.timestamp;
+
+    UNIQUE_LOCK(state.mtx, lk);
+
+    if (state.timestamp != -1 && ts > state.timestamp && state.count == state.buffer.size()) {
+        if (policy_ == ReorderPolicy::kSkipFrame && !state.releasing) {
+            DLOG(WARNING) << "Reorder buffer full, discarding incomplete frame: " << state.timestamp;
+            _skipFrame(state);
+            _release(state, lk, cb);
+        } else if (policy_ == ReorderPolicy::kDropNewest && packets.first.channel == Channel::kEndFrame) {
+            // Nothing new can be buffered, so later frames ending is the only
+            // sign that a packet of the current frame was lost.
+            ++state.droppedEndFrames;
+            if (!state.releasing && state.bufferedEndFrames + state.droppedEndFrames > max_frames_) {
+                DLOG(WARNING) << "Discarding incomplete frame: " << state.timestamp;
+                _skipFrame(state);
+                _release(state, lk, cb);
+            }
+        }
+
+        if (state.count == state.buffer.size()) {
+            DLOG(WARNING) << "Reorder buffer full, discarding packet: " << ts;
+            ++drops_;
             return;
         }
+    }
 
-        // Add packet to buffer;
-        auto wpos = state.writePos++;
-        state.buffer[wpos % StreamState::kMaxBuffer] = std::move(packets);
-        lk.unlock();
+    if (state.timestamp == -1) state.timestamp = ts;
 
+    if (state.timestamp == ts) {
         if (packets.first.channel == Channel::kEndFrame) {
-            ++state.bufferedEndFrames;
+            state.expected = packets.second.packet_count;
         }
 
-        if (state.bufferedEndFrames > 4) {
-            DLOG(WARNING) << "Discarding incomplete frame: " << state.timestamp;
-            UNIQUE_LOCK(state.mtx, lk);
-            if (state.bufferedEndFrames > 4) {
-                state.processed = 0;
-                state.expected = -1;
-
-                size_t start = state.readPos;
-                size_t stop = state.writePos;
-                state.readPos = stop;
-
-                int64_t ts = std::numeric_limits<int64_t>::max();
-                for (size_t i = start; i < stop; ++i) {
-                    ts = std::min(
-                        ts,
-                        state.buffer[i % StreamState::kMaxBuffer].first.timestamp);
-                }
+        lk.unlock();
+        cb(packets);
+        lk.lock();
 
-                state.timestamp = ts;
-
-                lk.unlock();
-                // Loop over the buffer, checking for anything that can be processed
-                for (size_t i = start; i < stop; ++i) {
-                    if (state.buffer[i % StreamState::kMaxBuffer].first.channel == Channel::kEndFrame) {
-                        --state.bufferedEndFrames;
-                    }
-                    submit(state.buffer[i % StreamState::kMaxBuffer], cb, true);
-                    std::vector<uint8_t> temp;
-                    state.buffer[i % StreamState::kMaxBuffer].second.data.swap(temp);
-                }
-            }
+        // The frame may have been given up while in the callback
+        if (state.timestamp == ts) ++state.processed;
+        _release(state, lk, cb);
+    } else if (state.timestamp > ts) {
+        lk.unlock();
+        DLOG(WARNING) << "Old packet received";
+        // Note: not ideal but still better than discarding
+        cb(packets);
+    } else {
+        // Add packet to buffer
+        PacketPair &slot = state.buffer[(state.head + state.count) % state.buffer.size()];
+        slot = std::move(packets);
+        ++state.count;
+
+        if (slot.first.channel == Channel::kEndFrame &&
+                ++state.bufferedEndFrames + state.droppedEndFrames > max_frames_) {
+            DLOG(WARNING) << "Discarding incomplete frame: " << state.timestamp;
+            _skipFrame(state);
+            _release(state, lk, cb);
         }
     }
 }
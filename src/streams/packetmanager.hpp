@@ -12,41 +12,97 @@
 #include <unordered_map>
 #include <memory>
 #include <tuple>
-#include <array>
+#include <vector>
 #include <ftl/protocol/packet.hpp>
 #include <ftl/threads.hpp>
 #include <ftl/protocol/frameid.hpp>
 
 namespace ftl {
 
-struct StreamState {
-    static constexpr int kMaxBuffer = 100;
+/**
+ * @brief What to do when a packet arrives and the reorder window is full.
+ */
+enum class ReorderPolicy {
+    kSkipFrame,     /// Give up on the incomplete frame and release buffered packets
+    kDropNewest,    /// Discard the packet that does not fit
+};
 
-    SHARED_MUTEX mtx;
-    std::array<ftl::protocol::PacketPair, kMaxBuffer> buffer;
+/**
+ * @brief Reorder buffer for one FrameID. The buffer is a ring that is allocated
+ * once, when the FrameID is first seen, and packets are moved in and out of it.
+ */
+struct StreamState {
+    MUTEX mtx;
+    std::vector<ftl::protocol::PacketPair> buffer;
+    size_t head = 0;
+    size_t count = 0;
 
     int64_t timestamp = -1;
     int expected = -1;
-    std::atomic_int processed = 0;
-    size_t readPos = 0;
-    size_t writePos = 0;
-    std::atomic_int bufferedEndFrames = 0;
+    int processed = 0;
+    int bufferedEndFrames = 0;
+    int droppedEndFrames = 0;  // Later frames that ended while the window was full
+    bool releasing = false;
+    bool rescan = false;     // Frame was given up, check the buffer again
 };
 
+/**
+ * @brief Deliver packets one frame at a time. Packets for a later frame are
+ * held back until the current frame has all of its packets, or until too
+ * many later frames are waiting, at which point the current frame is given up.
+ */
 class PacketManager {
  public:
+    static constexpr size_t kDefaultWindow = 100;
+    static constexpr int kDefaultMaxFrames = 4;
+
+    PacketManager() = default;
+    PacketManager(size_t window, int frames, ReorderPolicy policy = ReorderPolicy::kSkipFrame);
+
+    /**
+     * @brief Pass a packet to the callback now, or hold it back until its
+     * frame is next. The packet may be moved from.
+     */
     void submit(
         ftl::protocol::PacketPair &,
-        const std::function<void(const ftl::protocol::PacketPair &)> &,
-        bool noLoop = false);
+        const std::function<void(const ftl::protocol::PacketPair &)> &);
+
+    /**
+     * @brief Set the number of packets that can be held back for each FrameID,
+     * and the number of later frames that may be waiting before the current
+     * frame is given up. The window size applies to FrameIDs seen after this
+     * call, or after a reset.
+     */
+    void setWindow(size_t packets, int frames);
+
+    void setPolicy(ReorderPolicy policy) { policy_ = policy; }
+
+    /**
+     * @brief Number of frames given up incomplete plus the number of packets
+     * discarded because the window was full.
+     */
+    size_t dropCount() const { return drops_; }
 
+    /**
+     * @brief Forget all buffered packets. Must not be called during a submit.
+     */
     void reset();
 
  private:
     SHARED_MUTEX mtx_;
     std::unordered_map<uint32_t, StreamState> state_;
+    std::atomic_size_t window_ = kDefaultWindow;
+    std::atomic_int max_frames_ = kDefaultMaxFrames;
+    std::atomic<ReorderPolicy> policy_ = ReorderPolicy::kSkipFrame;
+    std::atomic_size_t drops_ = 0;
 
     StreamState &getState(ftl::protocol::FrameID);
+    void _skipFrame(StreamState &state);
+    static void _nextFrame(StreamState &state);
+    void _release(
+        StreamState &state,
+        std::unique_lock<MUTEX> &lk,
+        const std::function<void(const ftl::protocol::PacketPair &)> &);
 };
 
 }  // namespace ftl
@@ -0,0 +1,122 @@
+/**
+ * @file playbackscheduler.cpp
+ * @copyright Copyright (c) 2022 University of Turku, MIT License
+ */
+
+#include <algorithm>
+#include <ftl/time.hpp>
+#include "playbackscheduler.hpp"
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+using ftl::protocol::PlaybackScheduler;
+using std::chrono::steady_clock;
+using std::chrono::microseconds;
+
+PlaybackScheduler &PlaybackScheduler::getInstance() {
+    static PlaybackScheduler instance;
+    return instance;
+}
+
+PlaybackScheduler::~PlaybackScheduler() {
+    {
+        UNIQUE_LOCK(mtx_, lk);
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void PlaybackScheduler::add(const void *owner, const StepFunction &step) {
+    {
+        UNIQUE_LOCK(mtx_, lk);
+        entries_.push_back({owner, step, steady_clock::now()});
+        changed_ = true;
+
+        if (!running_) {
+            running_ = true;
+            thread_ = std::thread([this]() { _run(); });
+
+            #ifndef WIN32
+            sched_param p;
+            p.sched_priority = sched_get_priority_max(SCHED_RR);
+            pthread_setschedparam(thread_.native_handle(), SCHED_RR, &p);
+            #endif
+
+            // TODO(Nick): Windows thread priority
+        }
+    }
+    cv_.notify_all();
+}
+
+void PlaybackScheduler::remove(const void *owner) {
+    UNIQUE_LOCK(mtx_, lk);
+    for (auto &e : entries_) {
+        if (e.owner == owner) e.removed = true;
+    }
+    changed_ = true;
+
+    if (std::this_thread::get_id() != thread_.get_id()) {
+        cv_.wait(lk, [this, owner]() { return current_ != owner; });
+        entries_.remove_if([owner](const Entry &e) { return e.owner == owner; });
+    }
+    lk.unlock();
+    cv_.notify_all();
+}
+
+void PlaybackScheduler::wake(const void *owner) {
+    {
+        UNIQUE_LOCK(mtx_, lk);
+        for (auto &e : entries_) {
+            if (e.owner != owner || e.removed) continue;
+            e.due = steady_clock::now();
+            e.woken = true;
+            changed_ = true;
+        }
+    }
+    cv_.notify_all();
+}
+
+size_t PlaybackScheduler::size() const {
+    UNIQUE_LOCK(mtx_, lk);
+    return std::count_if(entries_.begin(), entries_.end(), [](const Entry &e) { return !e.removed; });
+}
+
+void PlaybackScheduler::_run() {
+    ftl::set_thread_name("playback");
+
+    UNIQUE_LOCK(mtx_, lk);
+    while (running_) {
+        entries_.remove_if([](const Entry &e) { return e.removed; });
+        changed_ = false;
+
+        const auto now = steady_clock::now();
+        const int64_t time = ftl::time::get_time();  // Same time for every stream in this pass
+        auto next = now + std::chrono::seconds(1);
+
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            auto &e = *it;
+            if (e.removed) continue;
+            if (e.due > now) {
+                next = std::min(next, e.due);
+                continue;
+            }
+
+            // Entry is not erased while it is current
+            current_ = e.owner;
+            e.woken = false;
+            lk.unlock();
+            int64_t delay = e.step(time);
+            lk.lock();
+            current_ = nullptr;
+            cv_.notify_all();
+
+            e.due = (e.woken) ? steady_clock::now() : now + microseconds(std::max(int64_t(0), delay));
+            next = std::min(next, e.due);
+        }
+
+        cv_.wait_until(lk, next, [this]() { return !running_ || changed_; });
+    }
+}
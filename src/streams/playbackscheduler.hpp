@@ -0,0 +1,78 @@
+/**
+ * @file playbackscheduler.hpp
+ * @copyright Copyright (c) 2022 University of Turku, MIT License
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <ftl/threads.hpp>
+
+namespace ftl {
+namespace protocol {
+
+/**
+ * One real-time thread that drives the playback of all recorded streams.
+ * Every stream that is due in a pass is stepped with the same time, so
+ * streams with equal frame intervals release their frames together.
+ */
+class PlaybackScheduler {
+ public:
+    /**
+     * Called with the current time in milliseconds, returns the number of
+     * microseconds until it should be called again. Steps share the thread,
+     * so anything that may block, such as file I/O, belongs on ftl::pool.
+     */
+    using StepFunction = std::function<int64_t(int64_t)>;
+
+    static PlaybackScheduler &getInstance();
+
+    ~PlaybackScheduler();
+
+    /** Start stepping a stream, it is first stepped immediately. */
+    void add(const void *owner, const StepFunction &step);
+
+    /**
+     * Stop stepping a stream. Waits for a step in progress to finish unless
+     * called from within that step.
+     */
+    void remove(const void *owner);
+
+    /**
+     * Step a stream as soon as possible instead of waiting for its delay,
+     * may be called from any thread.
+     */
+    void wake(const void *owner);
+
+    /** Number of streams being stepped. */
+    size_t size() const;
+
+ private:
+    PlaybackScheduler() = default;
+
+    struct Entry {
+        const void *owner;
+        StepFunction step;
+        std::chrono::steady_clock::time_point due;
+        bool removed = false;
+        bool woken = false;     // Woken while being stepped
+    };
+
+    std::list<Entry> entries_;
+    const void *current_ = nullptr;     // Owner being stepped
+    bool changed_ = false;
+    bool running_ = false;
+    std::thread thread_;
+    mutable MUTEX mtx_;
+    std::condition_variable cv_;
+
+    void _run();
+};
+
+}  // namespace protocol
+}  // namespace ftl
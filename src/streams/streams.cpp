@@ -7,6 +7,7 @@
 #include <ftl/protocol/streams.hpp>
 #include <ftl/protocol/channelUtils.hpp>
 #include <ftl/protocol/channelSet.hpp>
+#include <ftl/exception.hpp>
 
 using ftl::protocol::Stream;
 using ftl::protocol::Channel;
@@ -19,12 +20,11 @@ std::string Stream::name() const {
 }
 
 bool Stream::available(FrameID id) const {
-    SHARED_LOCK(mtx_, lk);
-    return state_.count(id) > 0;
+    return _getState(id) != nullptr;
 }
 
 bool Stream::available(FrameID id, Channel channel) const {
-    auto state = _getState(id);
+    const auto *state = _getState(id);
     if (!state) return false;
     if (isPersistent(channel)) {
         SHARED_LOCK(mtx_, lk);
@@ -35,7 +35,7 @@ bool Stream::available(FrameID id, Channel channel) const {
 }
 
 bool Stream::available(FrameID id, const ChannelSet &channels) const {
-    auto state = _getState(id);
+    const auto *state = _getState(id);
     if (!state) return false;
     for (auto channel : channels) {
         if (isPersistent(channel)) {
@@ -49,7 +49,7 @@ bool Stream::available(FrameID id, const ChannelSet &channels) const {
 }
 
 ftl::protocol::ChannelSet Stream::channels(FrameID id) const {
-    auto state = _getState(id);
+    const auto *state = _getState(id);
     if (!state) return {};
 
     SHARED_LOCK(mtx_, lk);
@@ -67,76 +67,69 @@ ftl::protocol::ChannelSet Stream::channels(FrameID id) const {
 }
 
 std::unordered_set<FrameID> Stream::frames() const {
-    SHARED_LOCK(mtx_, lk);
     std::unordered_set<FrameID> result;
-    for (const auto &s : state_) {
-        result.insert(FrameID(s.first));
+    for (unsigned int fs = 0; fs < state_.size(); ++fs) {
+        const auto *row = state_[fs].load(std::memory_order_acquire);
+        if (!row) continue;
+        for (unsigned int src = 0; src < row->sources.size(); ++src) {
+            const auto *state = row->sources[src].load(std::memory_order_acquire);
+            if (state && state->present) result.emplace(fs, src);
+        }
     }
     return result;
 }
 
 std::unordered_set<FrameID> Stream::enabled() const {
-    SHARED_LOCK(mtx_, lk);
     std::unordered_set<FrameID> result;
-    for (const auto &s : state_) {
-        if (!s.second) continue;
-        if (s.second->enabled) {
-            result.emplace(s.first);
-        }
+    for (unsigned int fs = 0; fs < state_.size(); ++fs) {
+        auto fsresult = enabled(fs);
+        result.insert(fsresult.begin(), fsresult.end());
     }
     return result;
 }
 
 std::unordered_set<FrameID> Stream::enabled(unsigned int fs) const {
-    SHARED_LOCK(mtx_, lk);
     std::unordered_set<FrameID> result;
-    for (const auto &s : state_) {
-        if (!s.second) continue;
-        if (s.second->enabled && FrameID(s.first).frameset() == fs) {
-            result.emplace(s.first);
-        }
+    if (fs >= state_.size()) return result;
+    const auto *row = state_[fs].load(std::memory_order_acquire);
+    if (!row) return result;
+    for (unsigned int src = 0; src < row->sources.size(); ++src) {
+        const auto *state = row->sources[src].load(std::memory_order_acquire);
+        if (state && state->present && state->enabled) result.emplace(fs, src);
     }
     return result;
 }
 
 bool Stream::enabled(FrameID id) const {
-    auto state = _getState(id);
+    const auto *state = _getState(id);
     if (!state) return false;
     return state->enabled;
 }
 
 bool Stream::enabled(FrameID id, ftl::protocol::Channel channel) const {
     SHARED_LOCK(mtx_, lk);
-    auto it = state_.find(id);
-    if (it != state_.end()) {
-        if (!it->second) return false;
-        return it->second->selected.count(channel) > 0;
-    }
-    return false;
+    const auto *state = _getState(id);
+    if (!state) return false;
+    return state->selected.count(channel) > 0;
 }
 
 ftl::protocol::ChannelSet Stream::enabledChannels(FrameID id) const {
     SHARED_LOCK(mtx_, lk);
-    auto it = state_.find(id);
-    if (it != state_.end()) {
-        if (!it->second) return {};
-        return it->second->selected;
-    }
-    return {};
+    const auto *state = _getState(id);
+    if (!state) return {};
+    return state->selected;
 }
 
 bool Stream::enable(FrameID id) {
     UNIQUE_LOCK(mtx_, lk);
-    auto &p = state_[id];
-    if (!p) p = std::make_shared<Stream::FSState>();
+    auto *p = _makeState(id);
     p->enabled = true;
     return true;
 }
 
 bool Stream::enable(FrameID id, ftl::protocol::Channel channel) {
     UNIQUE_LOCK(mtx_, lk);
-    auto &p = state_[id];
-    if (!p) p = std::make_shared<Stream::FSState>();
+    auto *p = _makeState(id);
     p->enabled = true;
     p->selected.insert(channel);
     return true;
@@ -144,8 +137,7 @@ bool Stream::enable(FrameID id, ftl::protocol::Channel channel) {
 
 bool Stream::enable(FrameID id, const ftl::protocol::ChannelSet &channels) {
     UNIQUE_LOCK(mtx_, lk);
-    auto &p = state_[id];
-    if (!p) p = std::make_shared<Stream::FSState>();
+    auto *p = _makeState(id);
     p->enabled = true;
     p->selected.insert(channels.begin(), channels.end());
     return true;
@@ -153,15 +145,13 @@ bool Stream::enable(FrameID id, const ftl::protocol::ChannelSet &channels) {
 
 void Stream::disable(FrameID id) {
     UNIQUE_LOCK(mtx_, lk);
-    auto &p = state_[id];
-    if (!p) p = std::make_shared<Stream::FSState>();
+    auto *p = _makeState(id);
     p->enabled = false;
 }
 
 void Stream::disable(FrameID id, ftl::protocol::Channel channel) {
     UNIQUE_LOCK(mtx_, lk);
-    auto &p = state_[id];
-    if (!p) p = std::make_shared<Stream::FSState>();
+    auto *p = _makeState(id);
     p->selected.erase(channel);
     if (p->selected.size() == 0) {
         p->enabled = false;
@@ -170,8 +160,7 @@ void Stream::disable(FrameID id, ftl::protocol::Channel channel) {
 
 void Stream::disable(FrameID id, const ftl::protocol::ChannelSet &channels) {
     UNIQUE_LOCK(mtx_, lk);
-    auto &p = state_[id];
-    if (!p) p = std::make_shared<Stream::FSState>();
+    auto *p = _makeState(id);
     for (const auto &c : channels) {
         p->selected.erase(c);
     }
@@ -182,7 +171,15 @@ void Stream::disable(FrameID id, const ftl::protocol::ChannelSet &channels) {
 
 void Stream::reset() {
     UNIQUE_LOCK(mtx_, lk);
-    state_.clear();
+    for (auto &state : states_) {
+        state->present = false;
+        state->enabled = false;
+        state->selected.clear();
+        state->availablePersistent.clear();
+        state->availableLast = 0;
+        state->availableNext = 0;
+    }
+    size_ = 0;
 }
 
 void Stream::refresh() {}
@@ -191,26 +188,49 @@ void Stream::trigger(const ftl::protocol::StreamPacket &spkt, const ftl::protoco
     cb_.trigger(spkt, pkt);
 }
 
-std::shared_ptr<Stream::FSState> Stream::_getState(FrameID id) {
-    {
-        SHARED_LOCK(mtx_, lk);
-        auto it = state_.find(id);
-        if (it != state_.end()) return it->second;
+Stream::FSState *Stream::_makeState(FrameID id) {
+    if (id.frameset() >= state_.size()) throw FTL_Error("Frameset out of range: " << id.frameset());
+
+    auto *row = state_[id.frameset()].load(std::memory_order_acquire);
+    if (!row) {
+        rows_.push_back(std::make_unique<FSRow>());
+        row = rows_.back().get();
+        state_[id.frameset()].store(row, std::memory_order_release);
+    }
+
+    auto *state = row->sources[id.source()].load(std::memory_order_acquire);
+    if (!state) {
+        states_.push_back(std::make_unique<FSState>());
+        state = states_.back().get();
+        row->sources[id.source()].store(state, std::memory_order_release);
+    }
+
+    if (!state->present) {
+        state->present = true;
+        ++size_;
+    }
+    return state;
+}
+
+Stream::FSState *Stream::_getState(FrameID id) {
+    if (id.frameset() < state_.size()) {
+        const auto *row = state_[id.frameset()].load(std::memory_order_acquire);
+        auto *state = (row) ? row->sources[id.source()].load(std::memory_order_acquire) : nullptr;
+        if (state && state->present) return state;
     }
     UNIQUE_LOCK(mtx_, lk);
-    if (!state_[id]) state_[id] = std::make_shared<Stream::FSState>();
-    return state_[id];
+    return _makeState(id);
 }
 
-std::shared_ptr<Stream::FSState> Stream::_getState(FrameID id) const {
-    SHARED_LOCK(mtx_, lk);
-    auto it = state_.find(id);
-    if (it != state_.end()) return it->second;
-    return nullptr;
+const Stream::FSState *Stream::_getState(FrameID id) const {
+    if (id.frameset() >= state_.size()) return nullptr;
+    const auto *row = state_[id.frameset()].load(std::memory_order_acquire);
+    const auto *state = (row) ? row->sources[id.source()].load(std::memory_order_acquire) : nullptr;
+    return (state && state->present) ? state : nullptr;
 }
 
 void Stream::seen(FrameID id, ftl::protocol::Channel channel) {
-    auto state = _getState(id);
+    auto *state = _getState(id);
     if (channel == Channel::kEndFrame) {
         state->availableLast = static_cast<uint64_t>(state->availableNext);
         state->availableNext = 0;
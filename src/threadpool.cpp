@@ -0,0 +1,168 @@
+/**
+ * @file threadpool.cpp
+ * @copyright Copyright (c) 2022 University of Turku, MIT License
+ */
+
+#include <string>
+#include <ftl/threadpool.hpp>
+#include <ftl/threads.hpp>
+
+#define LOGURU_REPLACE_GLOG 1
+#include <ftl/lib/loguru.hpp>
+
+using ftl::ThreadPool;
+using ftl::detail::PoolTask;
+
+// Identifies the pool and worker queue of the current thread, if any
+static thread_local ThreadPool *tl_pool = nullptr;
+static thread_local size_t tl_index = 0;
+
+bool ThreadPool::Worker::push(PoolTask &task) {
+    std::unique_lock<std::mutex> lk(mtx);
+    if (count == jobs.size()) return false;
+    jobs[(head + count) % jobs.size()] = std::move(task);
+    ++count;
+    return true;
+}
+
+bool ThreadPool::Worker::pop(PoolTask &task) {
+    std::unique_lock<std::mutex> lk(mtx);
+    if (count == 0) return false;
+    task = std::move(jobs[head]);
+    head = (head + 1) % jobs.size();
+    --count;
+    return true;
+}
+
+void ThreadPool::start_(int nThreads) {
+    stop_ = false;
+    done_ = false;
+
+    workers_.clear();
+    for (int i = 0; i < nThreads; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    // All queues must exist before any worker starts stealing
+    for (int i = 0; i < nThreads; ++i) {
+        workers_[i]->thread = std::thread([this, i]() { run_(i); });
+    }
+    nthreads_ = nThreads;
+}
+
+void ThreadPool::restart(int nThreads) {
+    stop(true);
+    clear_();
+    start_(nThreads);
+}
+
+void ThreadPool::stop(bool isWait) {
+    if (isWait) {
+        if (done_ || stop_) return;
+        done_ = true;
+    } else {
+        if (stop_) return;
+        stop_ = true;
+    }
+
+    {
+        std::unique_lock<std::mutex> lk(sleep_mtx_);
+        sleep_cv_.notify_all();
+    }
+
+    for (auto &w : workers_) {
+        if (w->thread.joinable()) w->thread.join();
+    }
+    nthreads_ = 0;
+
+    // Worker queues are kept so that late posts from other threads are safe
+    clear_();
+}
+
+void ThreadPool::clear_() {
+    for (auto &w : workers_) {
+        std::unique_lock<std::mutex> lk(w->mtx);
+        for (auto &job : w->jobs) job.reset();
+        w->head = 0;
+        w->count = 0;
+    }
+    {
+        std::unique_lock<std::mutex> lk(overflow_mtx_);
+        overflow_.clear();
+    }
+    pending_ = 0;
+}
+
+void ThreadPool::post_(PoolTask &&task) {
+    // Stopped pools never run new jobs, drop it now
+    if (stop_ || (done_ && nthreads_ == 0)) return;
+
+    // Counted before queuing so a worker cannot take it first
+    ++pending_;
+
+    const size_t n = workers_.size();
+    bool queued = false;
+    if (n > 0) {
+        size_t start = (tl_pool == this) ? tl_index : next_.fetch_add(1, std::memory_order_relaxed) % n;
+        for (size_t i = 0; i < n && !queued; ++i) {
+            queued = workers_[(start + i) % n]->push(task);
+        }
+    }
+    if (!queued) {
+        std::unique_lock<std::mutex> lk(overflow_mtx_);
+        overflow_.push_back(std::move(task));
+    }
+
+    if (idle_ > 0) {
+        std::unique_lock<std::mutex> lk(sleep_mtx_);
+        sleep_cv_.notify_one();
+    }
+}
+
+bool ThreadPool::take_(size_t index, PoolTask &task) {
+    if (workers_[index]->pop(task)) return true;
+
+    // Steal from the other workers, oldest jobs first
+    const size_t n = workers_.size();
+    for (size_t i = 1; i < n; ++i) {
+        if (workers_[(index + i) % n]->pop(task)) return true;
+    }
+
+    std::unique_lock<std::mutex> lk(overflow_mtx_);
+    if (overflow_.empty()) return false;
+    task = std::move(overflow_.front());
+    overflow_.pop_front();
+    return true;
+}
+
+void ThreadPool::run_(size_t index) {
+    tl_pool = this;
+    tl_index = index;
+    ftl::set_thread_name("thread_pool/" + std::to_string(index));
+
+    while (true) {
+        PoolTask task;
+        if (take_(index, task)) {
+            --pending_;
+            try {
+                task(static_cast<int>(index));
+            } catch (const std::exception &e) {
+                LOG(ERROR) << "Thread pool job failed: " << e.what();
+            } catch (...) {
+                LOG(ERROR) << "Thread pool job failed: unknown exception";
+            }
+            // Release captures before a possible stop
+            task.reset();
+            if (stop_) break;
+            continue;
+        }
+
+        if (stop_ || (done_ && pending_ == 0)) break;
+
+        std::unique_lock<std::mutex> lk(sleep_mtx_);
+        ++idle_;
+        sleep_cv_.wait(lk, [this]() { return pending_ > 0 || stop_ || done_; });
+        --idle_;
+    }
+
+    tl_pool = nullptr;
+}
@@ -34,6 +34,14 @@
 #ifndef WIN32
 #include <signal.h>
 #include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #endif
 
 #ifdef HAVE_MSQUIC
@@ -46,6 +54,7 @@ using std::thread;
 using ftl::net::PeerTcp;
 using ftl::net::PeerPtr;
 using ftl::net::Universe;
+using ftl::net::IOBackend;
 using nlohmann::json;
 using ftl::UUID;
 using std::optional;
@@ -59,6 +68,12 @@ using std::chrono::milliseconds;
 
 constexpr int kDefaultMaxConnections = 10;
 
+#ifdef HAVE_EPOLL
+constexpr IOBackend kDefaultIOBackend = IOBackend::kEpoll;
+#else
+constexpr IOBackend kDefaultIOBackend = IOBackend::kPoll;
+#endif
+
 namespace ftl {
 namespace net {
 
@@ -75,6 +90,93 @@ std::unique_ptr<SocketServer> create_listener(const ftl::URI &uri) {
 struct NetImplDetail {
     std::vector<pollfd> pollfds;
     std::unordered_map<int, size_t> idMap;
+
+    #ifndef WIN32
+    int wakepipe[2] = {-1, -1};             // Interrupts poll() to rebuild pollfds
+    #endif
+
+    #ifdef HAVE_EPOLL
+    static constexpr int kMaxEvents = 64;
+    static constexpr size_t kMaxIOThreads = 64;
+
+    // epoll user data: socket in the high 32 bits, listener flag and slot index
+    // (listeners_ or peers_) in the low bits. The socket is kept so that events
+    // for a slot which has since been reused can be detected.
+    static constexpr uint64_t kListenerFlag = 1ull << 31;
+    static constexpr uint64_t kIndexMask = kListenerFlag - 1;
+
+    static uint64_t key(int sock, size_t ix, bool listener) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(sock)) << 32) |
+            (listener ? kListenerFlag : 0) | (ix & kIndexMask);
+    }
+
+    // One epoll set per I/O thread, the first also holds the listeners.
+    struct Reactor {
+        int epollfd;
+        int wakefd;                         // eventfd to interrupt epoll_wait()
+        std::vector<epoll_event> events;
+        std::atomic_int peers = 0;          // Peers pinned to this reactor
+
+        // Delayed flushes as (deadline, peer local id), in deadline order
+        MUTEX flush_mtx;
+        std::vector<std::pair<int64_t, int>> flushes;
+        std::vector<std::pair<int64_t, int>> flushes_due;
+
+        Reactor() :
+                epollfd(epoll_create1(EPOLL_CLOEXEC)),
+                wakefd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+                events(kMaxEvents) {
+            if (epollfd < 0) LOG(WARNING) << "epoll_create1() failed: " << strerror(errno);
+
+            if (epollfd >= 0 && wakefd >= 0) {
+                epoll_event ev = {};
+                ev.events = EPOLLIN;
+                ev.data.u64 = key(wakefd, kIndexMask, true);
+                epoll_ctl(epollfd, EPOLL_CTL_ADD, wakefd, &ev);
+            }
+        }
+
+        ~Reactor() {
+            if (epollfd >= 0) ::close(epollfd);
+            if (wakefd >= 0) ::close(wakefd);
+        }
+    };
+
+    // Reserved up front and never shrinks, I/O threads read it without a lock.
+    std::vector<std::unique_ptr<Reactor>> reactors;
+
+    // TCP peers registered with epoll, indexed by local id (slot in peers_).
+    std::vector<PeerTcpPtr> tcpPeers;
+
+    bool hasEpoll() const { return reactors[0]->epollfd >= 0; }
+    #endif
+
+    NetImplDetail() {
+        #ifndef WIN32
+        if (pipe(wakepipe) == 0) {
+            for (int fd : wakepipe) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+        } else {
+            LOG(WARNING) << "pipe() failed: " << strerror(errno);
+            wakepipe[0] = wakepipe[1] = -1;
+        }
+        #endif
+
+        #ifdef HAVE_EPOLL
+        reactors.reserve(kMaxIOThreads);
+        reactors.push_back(std::make_unique<Reactor>());
+        #endif
+    }
+
+    ~NetImplDetail() {
+        #ifndef WIN32
+        for (int fd : wakepipe) {
+            if (fd >= 0) ::close(fd);
+        }
+        #endif
+    }
 };
 
 }  // namespace net
@@ -94,6 +196,7 @@ Universe::Universe() :
         active_(true),
         this_peer(ftl::protocol::id),
         impl_(new ftl::net::NetImplDetail()),
+        backend_(kDefaultIOBackend),
         peers_(kDefaultMaxConnections),
         phase_(0),
         periodic_time_(0.67),
@@ -120,6 +223,63 @@ void Universe::setMaxConnections(size_t m) {
     peers_.resize(m);
 }
 
+void Universe::setIOBackend(IOBackend b) {
+    #ifdef HAVE_EPOLL
+    if (b == IOBackend::kEpoll && !impl_->hasEpoll()) {
+        LOG(WARNING) << "epoll not available, using poll";
+        b = IOBackend::kPoll;
+    }
+    #else
+    if (b == IOBackend::kEpoll) {
+        LOG(WARNING) << "Built without epoll support, using poll";
+        b = IOBackend::kPoll;
+    }
+    #endif
+    backend_ = b;
+}
+
+void Universe::setIOThreads(size_t n) {
+    n = std::max<size_t>(n, 1);
+
+    #ifdef HAVE_EPOLL
+    if (n > NetImplDetail::kMaxIOThreads) {
+        LOG(WARNING) << "Too many I/O threads requested: " << n;
+        n = NetImplDetail::kMaxIOThreads;
+    }
+
+    std::vector<std::thread> stopping;
+
+    {
+        UNIQUE_LOCK(net_mutex_, lk);
+        if (connection_count_ > 0) {
+            throw FTL_Error("Cannot change number of I/O threads with active connections");
+        }
+
+        // Extra threads exit once their index is beyond the count.
+        io_thread_count_ = std::min(n, io_threads_.size() + 1);
+        while (io_threads_.size() + 1 > n) {
+            stopping.push_back(std::move(io_threads_.back()));
+            io_threads_.pop_back();
+        }
+
+        while (io_threads_.size() + 1 < n) {
+            const size_t ix = io_threads_.size() + 1;
+            if (impl_->reactors.size() <= ix) {
+                auto reactor = std::make_unique<NetImplDetail::Reactor>();
+                if (reactor->epollfd < 0) break;
+                impl_->reactors.push_back(std::move(reactor));
+            }
+            io_thread_count_ = ix + 1;
+            io_threads_.emplace_back(&Universe::_runIOThread, this, ix);
+        }
+    }
+
+    for (auto &t : stopping) t.join();
+    #else
+    if (n > 1) LOG(WARNING) << "Multiple I/O threads require epoll support";
+    #endif
+}
+
 size_t Universe::getSendBufferSize(ftl::URI::scheme_t s) {
     switch (s) {
         case ftl::URI::scheme_t::SCHEME_WS:
@@ -210,6 +370,8 @@ void Universe::shutdown() {
 
     active_ = false;
     thread_.join();
+    for (auto &t : io_threads_) t.join();
+    io_threads_.clear();
 
     _cleanupPeers();
     while (garbage_.size() > 0) {
@@ -242,6 +404,7 @@ bool Universe::listen(const ftl::URI &addr) {
             UNIQUE_LOCK(net_mutex_, lk);
             LOG(INFO) << "Listening on " << l->uri().to_string();
             listeners_.push_back(std::move(l));
+            _registerListener(listeners_.size() - 1);
         }
         socket_cv_.notify_one();
         return true;
@@ -289,8 +452,11 @@ void Universe::insertPeer_(const PeerPtr &ptr) {
             peer_ids_[ptr->id()] = i;
             ptr->local_id_ = i;
 
+            auto p_tcp = std::dynamic_pointer_cast<PeerTcp>(ptr);
+            if (p_tcp) _registerPeer(p_tcp);
+
             lk.unlock();
-            if (dynamic_cast<PeerTcp*>(ptr.get())) {
+            if (p_tcp) {
                 socket_cv_.notify_one();
             }
             return;
@@ -392,6 +558,7 @@ void Universe::_setDescriptors() {
                 #else
                 fdentry.events = POLLIN;  // | POLLERR;
                 #endif
+                if (p->write_interest_) fdentry.events |= POLLOUT;
                 fdentry.fd = sock;
                 fdentry.revents = 0;
                 impl_->pollfds.push_back(fdentry);
@@ -399,6 +566,177 @@ void Universe::_setDescriptors() {
             }
         }
     }
+
+    // Last entry, so an empty set still means there are no sockets.
+    #ifndef WIN32
+    if (!impl_->pollfds.empty() && impl_->wakepipe[0] >= 0) {
+        pollfd fdentry;
+        fdentry.events = POLLIN;
+        fdentry.fd = impl_->wakepipe[0];
+        fdentry.revents = 0;
+        impl_->pollfds.push_back(fdentry);
+    }
+    #endif
+}
+
+void Universe::_wakePoll() {
+    #ifndef WIN32
+    if (impl_->wakepipe[1] < 0) return;
+    const char one = 1;
+    // A full pipe means a wake is already pending.
+    if (::write(impl_->wakepipe[1], &one, 1) < 0 && errno != EAGAIN) {
+        DLOG(WARNING) << "Poll wake failed: " << strerror(errno);
+    }
+    #endif
+    // WSAPoll cannot wait on a pipe, the 100ms timeout bounds the delay.
+}
+
+void Universe::_registerListener(size_t ix) {
+    #ifdef HAVE_EPOLL
+    if (!impl_->hasEpoll()) return;
+
+    const auto sock = listeners_[ix]->fd();
+    if (sock == INVALID_SOCKET) return;
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = NetImplDetail::key(sock, ix, true);
+    if (epoll_ctl(impl_->reactors[0]->epollfd, EPOLL_CTL_ADD, sock, &ev) != 0) {
+        LOG(ERROR) << "Could not add listener to epoll: " << strerror(errno);
+    }
+    #endif
+}
+
+void Universe::_registerPeer(const PeerTcpPtr &p) {
+    #ifdef HAVE_EPOLL
+    if (!impl_->hasEpoll() || p->local_id_ < 0) return;
+
+    // Pin to the least loaded I/O thread, kept over reconnects.
+    const int threads = static_cast<int>(io_thread_count_);
+    if (p->io_thread_ < 0 || p->io_thread_ >= threads) {
+        int best = 0;
+        for (int i = 1; i < threads; ++i) {
+            if (impl_->reactors[i]->peers < impl_->reactors[best]->peers) best = i;
+        }
+        p->io_thread_ = best;
+    }
+    auto &reactor = *impl_->reactors[p->io_thread_];
+
+    const size_t ix = static_cast<size_t>(p->local_id_);
+    if (impl_->tcpPeers.size() <= ix) impl_->tcpPeers.resize(ix + 1);
+    if (impl_->tcpPeers[ix] != p) {
+        impl_->tcpPeers[ix] = p;
+        ++reactor.peers;
+    }
+
+    // Not yet connected (reconnect pending) or a fake test socket.
+    const auto sock = p->_socket();
+    if (sock == INVALID_SOCKET) return;
+
+    // Level triggered: PeerTcp::recv() does a single read per notification on
+    // a blocking socket, any remaining data is reported again on next wait.
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.u64 = NetImplDetail::key(sock, ix, false);
+    if (epoll_ctl(reactor.epollfd, EPOLL_CTL_ADD, sock, &ev) != 0) {
+        if (errno != EEXIST || epoll_ctl(reactor.epollfd, EPOLL_CTL_MOD, sock, &ev) != 0) {
+            LOG(ERROR) << "Could not add socket to epoll: " << strerror(errno);
+        }
+    }
+    #endif
+}
+
+void Universe::_unregisterPeer(const PeerPtr &p) {
+    #ifdef HAVE_EPOLL
+    if (p->local_id_ < 0) return;
+
+    const size_t ix = static_cast<size_t>(p->local_id_);
+    if (ix >= impl_->tcpPeers.size() || impl_->tcpPeers[ix] != p) return;
+
+    // A closed socket is removed from the set by the kernel. Only remove it
+    // explicitly while still open, the descriptor could otherwise belong to
+    // a newer connection already.
+    auto &reactor = *impl_->reactors[p->io_thread_];
+    const auto sock = impl_->tcpPeers[ix]->_socket();
+    if (sock != INVALID_SOCKET) {
+        epoll_ctl(reactor.epollfd, EPOLL_CTL_DEL, sock, nullptr);
+    }
+    impl_->tcpPeers[ix].reset();
+    --reactor.peers;
+    #endif
+}
+
+void Universe::_setWriteInterest(PeerTcp *p, bool enable) {
+    #ifdef HAVE_EPOLL
+    if (impl_->hasEpoll() && p->io_thread_ >= 0 && p->local_id_ >= 0) {
+        const auto sock = p->_socket();
+        if (sock == INVALID_SOCKET) return;
+
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLRDHUP | (enable ? EPOLLOUT : 0);
+        ev.data.u64 = NetImplDetail::key(sock, p->local_id_, false);
+        epoll_ctl(impl_->reactors[p->io_thread_]->epollfd, EPOLL_CTL_MOD, sock, &ev);
+    }
+    if (backend_ == IOBackend::kEpoll) return;
+    #endif
+
+    // poll() only sees POLLOUT once the descriptors are rebuilt
+    if (enable) _wakePoll();
+}
+
+bool Universe::_scheduleFlush(PeerTcp *p) {
+    #ifdef HAVE_EPOLL
+    const int window = coalesce_window_;
+    if (window <= 0 || backend_ != IOBackend::kEpoll || p->io_thread_ < 0 || p->local_id_ < 0) return false;
+    // Fake test sockets are never polled, write those immediately.
+    if (p->_socket() == INVALID_SOCKET) return false;
+
+    auto &reactor = *impl_->reactors[p->io_thread_];
+    if (reactor.wakefd < 0) return false;
+
+    bool wake = false;
+    {
+        UNIQUE_LOCK(reactor.flush_mtx, lk);
+        wake = reactor.flushes.empty();
+        reactor.flushes.emplace_back(ftl::time::get_time() + window, p->local_id_);
+    }
+
+    // Waiting with a longer timeout, wake it to recalculate
+    if (wake) {
+        uint64_t one = 1;
+        if (::write(reactor.wakefd, &one, sizeof(one)) < 0) {
+            DLOG(WARNING) << "eventfd write failed: " << strerror(errno);
+        }
+    }
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+void Universe::_runFlushes(size_t reactor) {
+    #ifdef HAVE_EPOLL
+    auto &r = *impl_->reactors[reactor];
+    const int64_t now = ftl::time::get_time();
+
+    {
+        UNIQUE_LOCK(r.flush_mtx, lk);
+        auto it = r.flushes.begin();
+        while (it != r.flushes.end() && it->first <= now) ++it;
+        if (it == r.flushes.begin()) return;
+        r.flushes_due.assign(r.flushes.begin(), it);
+        r.flushes.erase(r.flushes.begin(), it);
+    }
+
+    for (const auto &f : r.flushes_due) {
+        PeerTcpPtr s;
+        {
+            SHARED_LOCK(net_mutex_, lk);
+            if (static_cast<size_t>(f.second) < impl_->tcpPeers.size()) s = impl_->tcpPeers[f.second];
+        }
+        if (s) s->flush();
+    }
+    #endif
 }
 
 void Universe::installBindings_(const PeerPtr &p) {}
@@ -411,6 +749,8 @@ void Universe::removePeer_(PeerPtr &p) {
     if (p && (!p->isValid() ||
             p->status() == NodeStatus::kReconnecting ||
             p->status() == NodeStatus::kDisconnected)) {
+        _unregisterPeer(p);
+
         auto ix = peer_ids_.find(p->id());
         if (ix != peer_ids_.end()) peer_ids_.erase(ix);
 
@@ -528,7 +868,11 @@ void Universe::_periodic() {
         insertPeer_(peer);
         peer->status_ = NodeStatus::kConnecting;
         i = reconnects_.erase(i);
-        peer->reconnect();
+        if (peer->reconnect()) {
+            // New socket, insertPeer_ only saw the closed one.
+            UNIQUE_LOCK(net_mutex_, lk);
+            _registerPeer(peer);
+        }
 
         /*if ((*i).peer->reconnect()) {
             insertPeer_((*i).peer);
@@ -590,9 +934,6 @@ void Universe::_run() {
     auto start = std::chrono::high_resolution_clock::now();
 
     while (active_) {
-        _setDescriptors();
-        int selres = 1;
-
         _cleanupPeers();
 
         // Do periodics
@@ -603,113 +944,238 @@ void Universe::_run() {
             _periodic();
         }
 
-        // It is an error to use "select" with no sockets ... so just sleep
-        if (impl_->pollfds.size() == 0) {
-            SHARED_LOCK(net_mutex_, lk);
-            socket_cv_.wait_for(
-                lk,
-                milliseconds(100),
-                [this](){ return listeners_.size() > 0 || connection_count_ > 0; });
-            continue;
+        if (backend_ == IOBackend::kEpoll) {
+            _runEpoll();
+        } else {
+            _runPoll();
         }
+    }
+
+    // Garbage is a threadsafe container, moving there first allows the destructor to be called
+    // without the lock.
+    {
+        UNIQUE_LOCK(net_mutex_, lk);
+        garbage_.insert(garbage_.end(), peers_.begin(), peers_.end());
+        reconnects_.clear();
+        peers_.clear();
+        peer_by_uri_.clear();
+        peer_ids_.clear();
+        listeners_.clear();
+        #ifdef HAVE_EPOLL
+        impl_->tcpPeers.clear();
+        #endif
+    }
+
+    garbage_.clear();
+}
+
+void Universe::_runPoll() {
+    _setDescriptors();
+    int selres = 1;
+
+    // It is an error to use "select" with no sockets ... so just sleep
+    if (impl_->pollfds.size() == 0) {
+        SHARED_LOCK(net_mutex_, lk);
+        socket_cv_.wait_for(
+            lk,
+            milliseconds(100),
+            [this](){ return listeners_.size() > 0 || connection_count_ > 0; });
+        return;
+    }
+
+    #ifdef WIN32
+    selres = WSAPoll(impl_->pollfds.data(), impl_->pollfds.size(), 100);
+    #else
+    selres = poll(impl_->pollfds.data(), impl_->pollfds.size(), 100);
+    #endif
 
+    // Some kind of error occured, it is usually possible to recover from this.
+    if (selres < 0) {
         #ifdef WIN32
-        selres = WSAPoll(impl_->pollfds.data(), impl_->pollfds.size(), 100);
+        int errNum = WSAGetLastError();
+        switch (errNum) {
+        case WSAENOTSOCK    : return;  // Socket was closed
+        default             : DLOG(WARNING) << "Unhandled poll error: " << errNum;
+        }
         #else
-        selres = poll(impl_->pollfds.data(), impl_->pollfds.size(), 100);
+        switch (errno) {
+        case 9  : return;  // Bad file descriptor = socket closed
+        case 4  : return;  // Interrupted system call ... no problem
+        default : DLOG(WARNING) << "Unhandled poll error: " << strerror(errno) << "(" << errno << ")";
+        }
         #endif
+        return;
+    } else if (selres == 0) {
+        // Timeout, nothing to do...
+        return;
+    }
 
-        // Some kind of error occured, it is usually possible to recover from this.
-        if (selres < 0) {
-            #ifdef WIN32
-            int errNum = WSAGetLastError();
-            switch (errNum) {
-            case WSAENOTSOCK    : continue;  // Socket was closed
-            default             : DLOG(WARNING) << "Unhandled poll error: " << errNum;
+    #ifndef WIN32
+    if (impl_->wakepipe[0] >= 0 && (impl_->pollfds.back().revents & POLLIN)) {
+        char drain[64];
+        while (::read(impl_->wakepipe[0], drain, sizeof(drain)) > 0) {}
+    }
+    #endif
+
+    SHARED_LOCK(net_mutex_, lk);
+
+    // If connection request is waiting
+    for (auto &l : listeners_) {
+        if (l && l->is_listening() && (impl_->pollfds[impl_->idMap[l->fd()]].revents & POLLIN)) {
+            std::unique_ptr<ftl::net::internal::SocketConnection> csock;
+            try {
+                csock = l->accept();
+            } catch (const std::exception &ex) {
+                notifyError_(nullptr, ftl::protocol::Error::kConnectionFailed, ex.what());
             }
-            #else
-            switch (errno) {
-            case 9  : continue;  // Bad file descriptor = socket closed
-            case 4  : continue;  // Interrupted system call ... no problem
-            default : DLOG(WARNING) << "Unhandled poll error: " << strerror(errno) << "(" << errno << ")";
+
+            lk.unlock();
+
+            if (csock) {
+                auto p = std::make_shared<PeerTcp>(std::move(csock), this, &disp_);
+                insertPeer_(p);
+                p->start();
             }
-            #endif
-            continue;
-        } else if (selres == 0) {
-            // Timeout, nothing to do...
-            continue;
+
+            lk.lock();
         }
+    }
 
-        SHARED_LOCK(net_mutex_, lk);
 
-        // If connection request is waiting
-        for (auto &l : listeners_) {
-            if (l && l->is_listening() && (impl_->pollfds[impl_->idMap[l->fd()]].revents & POLLIN)) {
-                std::unique_ptr<ftl::net::internal::SocketConnection> csock;
-                try {
-                    csock = l->accept();
-                } catch (const std::exception &ex) {
-                    notifyError_(nullptr, ftl::protocol::Error::kConnectionFailed, ex.what());
-                }
+    // Also check each clients socket to see if any messages or errors are waiting
+    for (size_t p = 0; p < peers_.size(); ++p) {
+        // FIXME: dynamic cast not necessary here
+        auto* s = dynamic_cast<PeerTcp*>(peers_[(p+phase_)%peers_.size()].get());
 
-                lk.unlock();
+        if (s && s->isValid()) {
+            // Note: It is possible that the socket becomes invalid after check but before
+            // looking at the FD sets, therefore cache the original socket
+            SOCKET sock = s->_socket();
+            if (sock == INVALID_SOCKET) continue;
 
-                if (csock) {
-                    auto p = std::make_shared<PeerTcp>(std::move(csock), this, &disp_);
-                    insertPeer_(p);
-                    p->start();
-                }
+            if (impl_->idMap.count(sock) == 0) continue;
 
+            const auto &fdstruct = impl_->pollfds[impl_->idMap[sock]];
+
+            // This is needed on Windows to detect socket close.
+            if (fdstruct.revents & POLLERR) {
+                if (s->socketError()) {
+                    continue;  // No point in reading data...
+                }
+            }
+            if (fdstruct.revents & POLLOUT) {
+                lk.unlock();
+                s->_flushSendQueue();
+                lk.lock();
+            }
+            // If message received from this client then deal with it
+            if (fdstruct.revents & POLLIN) {
+                lk.unlock();
+                s->recv();
                 lk.lock();
             }
         }
+    }
+    ++phase_;
+}
 
+void Universe::_runIOThread(size_t reactor) {
+    set_thread_name("net/io" + std::to_string(reactor));
 
-        // Also check each clients socket to see if any messages or errors are waiting
-        for (size_t p = 0; p < peers_.size(); ++p) {
-            // FIXME: dynamic cast not necessary here
-            auto* s = dynamic_cast<PeerTcp*>(peers_[(p+phase_)%peers_.size()].get());
+    while (active_ && reactor < io_thread_count_) {
+        // poll backend handles all peers on the network thread
+        if (backend_ != IOBackend::kEpoll) {
+            std::this_thread::sleep_for(milliseconds(100));
+            continue;
+        }
+        _runEpoll(reactor);
+    }
+}
 
-            if (s && s->isValid()) {
-                // Note: It is possible that the socket becomes invalid after check but before
-                // looking at the FD sets, therefore cache the original socket
-                SOCKET sock = s->_socket();
-                if (sock == INVALID_SOCKET) continue;
+void Universe::_runEpoll(size_t reactor) {
+    #ifdef HAVE_EPOLL
+    auto &r = *impl_->reactors[reactor];
+    auto &events = r.events;
 
-                if (impl_->idMap.count(sock) == 0) continue;
+    // Wake up in time for the first delayed flush
+    int timeout = 100;
+    {
+        UNIQUE_LOCK(r.flush_mtx, lk);
+        if (!r.flushes.empty()) {
+            timeout = static_cast<int>(std::clamp<int64_t>(r.flushes.front().first - ftl::time::get_time(), 0, 100));
+        }
+    }
 
-                const auto &fdstruct = impl_->pollfds[impl_->idMap[sock]];
+    const int count = epoll_wait(r.epollfd, events.data(), static_cast<int>(events.size()), timeout);
+    _runFlushes(reactor);
 
-                // This is needed on Windows to detect socket close.
-                if (fdstruct.revents & POLLERR) {
-                    if (s->socketError()) {
-                        continue;  // No point in reading data...
-                    }
-                }
-                // If message received from this client then deal with it
-                if (fdstruct.revents & POLLIN) {
-                    lk.unlock();
-                    s->recv();
-                    lk.lock();
+    if (count < 0) {
+        if (errno != EINTR) {
+            DLOG(WARNING) << "Unhandled epoll error: " << strerror(errno) << "(" << errno << ")";
+        }
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        const uint64_t key = events[i].data.u64;
+        const uint32_t revents = events[i].events;
+        const int sock = static_cast<int>(key >> 32);
+        const size_t ix = key & NetImplDetail::kIndexMask;
+
+        if (key & NetImplDetail::kListenerFlag) {
+            // Woken for delayed flush, handled before next wait
+            if (ix == NetImplDetail::kIndexMask) {
+                uint64_t value;
+                [[maybe_unused]] auto rc = ::read(sock, &value, sizeof(value));
+                continue;
+            }
+
+            std::unique_ptr<ftl::net::internal::SocketConnection> csock;
+            {
+                SHARED_LOCK(net_mutex_, lk);
+                if (ix >= listeners_.size()) continue;
+                const auto &l = listeners_[ix];
+                if (!l || !l->is_listening() || l->fd() != sock) continue;
+
+                try {
+                    csock = l->accept();
+                } catch (const std::exception &ex) {
+                    notifyError_(nullptr, ftl::protocol::Error::kConnectionFailed, ex.what());
                 }
             }
+
+            if (csock) {
+                auto p = std::make_shared<PeerTcp>(std::move(csock), this, &disp_);
+                insertPeer_(p);
+                p->start();
+            }
+            continue;
         }
-        ++phase_;
-    }
 
-    // Garbage is a threadsafe container, moving there first allows the destructor to be called
-    // without the lock.
-    {
-        UNIQUE_LOCK(net_mutex_, lk);
-        garbage_.insert(garbage_.end(), peers_.begin(), peers_.end());
-        reconnects_.clear();
-        peers_.clear();
-        peer_by_uri_.clear();
-        peer_ids_.clear();
-        listeners_.clear();
-    }
+        PeerTcpPtr s;
+        {
+            SHARED_LOCK(net_mutex_, lk);
+            if (ix < impl_->tcpPeers.size()) s = impl_->tcpPeers[ix];
+        }
 
-    garbage_.clear();
+        // Slot emptied or reused by another connection since the wait.
+        if (!s || !s->isValid() || s->_socket() != sock) continue;
+
+        if (revents & EPOLLERR) {
+            if (s->socketError()) {
+                continue;  // No point in reading data...
+            }
+        }
+        if (revents & EPOLLOUT) {
+            s->_flushSendQueue();
+        }
+        if (revents & (EPOLLIN | EPOLLHUP | EPOLLRDHUP)) {
+            s->recv();
+        }
+    }
+    #else
+    _runPoll();
+    #endif
 }
 
 ftl::Handle Universe::onConnect(const std::function<bool(const PeerPtr&)> &cb) {
@@ -59,6 +59,14 @@ struct NetImplDetail;
 
 using Callback = unsigned int;
 
+/**
+ * Socket readiness mechanism used by the network thread of a Universe.
+ */
+enum class IOBackend {
+    kPoll,      // poll()/WSAPoll(), descriptor set rebuilt on every iteration
+    kEpoll      // epoll (Linux only), sockets registered once when added
+};
+
 /**
  * Represents a group of network peers and their resources, managing the
  * searching of and sharing of resources across peers. Each universe can
@@ -209,6 +217,35 @@ class Universe {
     void setMaxConnections(size_t m);
     size_t getMaxConnections() const { return peers_.size(); }
 
+    /**
+     * Select how the network thread waits for socket activity. epoll is the
+     * default where available, poll is kept as a portable fallback. Requesting
+     * epoll where it is not supported leaves poll in use. Takes effect on the
+     * next iteration of the network thread.
+     */
+    void setIOBackend(IOBackend b);
+    IOBackend getIOBackend() const { return backend_; }
+
+    /**
+     * Set the number of threads performing socket I/O (epoll only). The
+     * network thread counts as the first, each additional thread has its own
+     * epoll set. Peers are pinned to the least loaded thread when inserted,
+     * including connections accepted by listeners. Must be set while there
+     * are no connections.
+     *
+     * @param n Number of I/O threads, at least 1.
+     */
+    void setIOThreads(size_t n);
+    size_t getIOThreads() const { return io_thread_count_; }
+
+    /**
+     * Maximum time in milliseconds that messages sent with SendFlags::DELAY
+     * are held back to be written together with following messages. Zero
+     * disables coalescing. Only used with the epoll backend.
+     */
+    void setCoalesceWindow(int ms) { coalesce_window_ = ms; }
+    int getCoalesceWindow() const { return coalesce_window_; }
+
     // --- Test support -------------------------------------------------------
 
     PeerTcpPtr injectFakePeer(std::unique_ptr<ftl::net::internal::SocketConnection> s);
@@ -228,6 +265,29 @@ class Universe {
     void _setDescriptors();
     void _cleanupPeers();
 
+    // One wait and dispatch step of the network thread for each IOBackend
+    void _runPoll();
+    void _runEpoll(size_t reactor = 0);
+
+    // Additional I/O thread body, handles peers pinned to the reactor.
+    void _runIOThread(size_t reactor);
+
+    // Add or remove a socket from the epoll set, net_mutex_ must be locked.
+    void _registerListener(size_t ix);
+    void _registerPeer(const PeerTcpPtr &p);
+    void _unregisterPeer(const PeerPtr &p);
+
+    // Request writable notifications while a peer has queued send data.
+    void _setWriteInterest(PeerTcp *p, bool enable);
+
+    // Interrupt poll() so that the descriptors are rebuilt.
+    void _wakePoll();
+
+    // Call PeerTcp::flush() from I/O thread after the coalescing window.
+    // Returns false if not possible, peer should flush immediately.
+    bool _scheduleFlush(PeerTcp *p);
+    void _runFlushes(size_t reactor);
+
     // no-op? TODO: remove
     void installBindings_();
     void installBindings_(const ftl::net::PeerPtr&);
@@ -239,12 +299,17 @@ class Universe {
 
     static void __start(Universe *u);
 
+    std::vector<std::thread> io_threads_;           // Excludes thread_
+    std::atomic_size_t io_thread_count_ = 1;
+    std::atomic_int coalesce_window_ = 1;
+
     std::atomic_bool active_;
     ftl::UUID this_peer;
     mutable DECLARE_SHARED_MUTEX(net_mutex_);
     std::condition_variable_any socket_cv_;
 
     std::unique_ptr<NetImplDetail> impl_;
+    std::atomic<IOBackend> backend_;
 
     // Statistics data.
     float stats_txkbps_ = 0.0f;
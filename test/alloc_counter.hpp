@@ -0,0 +1,48 @@
+/**
+ * Counts heap allocations made by the test thread. Replaces the global
+ * operator new and delete, so include it in one source file per test.
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <new>
+
+// Only allocations made by the test thread are counted
+static thread_local bool count_allocs_ = false;
+static thread_local size_t allocs_ = 0;
+
+void *operator new(std::size_t size) {
+    if (count_allocs_) ++allocs_;
+    void *p = std::malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+// GCC flags free() of memory from the replaced operator new once inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Allocations made by f()
+template <typename F>
+static size_t countAllocs(F f) {
+    allocs_ = 0;
+    count_allocs_ = true;
+    f();
+    count_allocs_ = false;
+    return allocs_;
+}
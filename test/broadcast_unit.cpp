@@ -4,6 +4,11 @@
 #include <ftl/protocol/muxer.hpp>
 #include <ftl/protocol/broadcaster.hpp>
 #include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 using ftl::protocol::Muxer;
 using ftl::protocol::Broadcast;
@@ -72,6 +77,95 @@ TEST_CASE("ftl::stream::Broadcast()::write", "[stream]") {
 
 }
 
+TEST_CASE("Broadcast concurrent post", "[stream]") {
+    std::unique_ptr<Broadcast> mux = std::make_unique<Broadcast>();
+    REQUIRE(mux);
+
+    std::shared_ptr<Stream> s1 = std::make_shared<BTestStream>();
+    std::shared_ptr<Stream> s2 = std::make_shared<BTestStream>();
+    mux->add(s1);
+    mux->add(s2);
+
+    // s1 is slow to post
+    std::vector<int64_t> ts1;
+    std::vector<int64_t> ts2;
+    auto h1 = s1->onPacket([&ts1](const StreamPacket &spkt, const DataPacket &pkt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ts1.push_back(spkt.timestamp);
+        return true;
+    });
+    auto h2 = s2->onPacket([&ts2](const StreamPacket &spkt, const DataPacket &pkt) {
+        ts2.push_back(spkt.timestamp);
+        return true;
+    });
+
+    SECTION("posts in order without waiting for a slow stream") {
+        mux->setProperty(ftl::protocol::StreamProperty::kConcurrent, true);
+        REQUIRE( std::any_cast<bool>(mux->getProperty(ftl::protocol::StreamProperty::kConcurrent)) );
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE( mux->post({4,100+i,0,1,Channel::kColour},{}) );
+        }
+        REQUIRE( std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100) );
+
+        // Waits for queued packets
+        mux->setConcurrent(false);
+
+        REQUIRE( ts1.size() == 10 );
+        REQUIRE( ts2.size() == 10 );
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE( ts1[i] == 100+i );
+            REQUIRE( ts2[i] == 100+i );
+        }
+    }
+
+    SECTION("counts dropped packets for each stream") {
+        mux->setConcurrent(true, 2);
+
+        int failed = 0;
+        for (int i = 0; i < 10; ++i) {
+            if (!mux->post({4,100+i,0,1,Channel::kColour},{})) ++failed;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        auto drops = mux->dropCounts();
+        const int total = std::any_cast<int>(mux->getProperty(ftl::protocol::StreamProperty::kDropCount));
+        mux->clear();
+
+        REQUIRE( total == failed );
+        REQUIRE( drops.size() == 2 );
+        REQUIRE( drops[0] > 0 );
+        REQUIRE( drops[1] == 0 );
+        REQUIRE( static_cast<int>(drops[0]) == failed );
+        REQUIRE( ts1.size() + drops[0] == 10 );
+        REQUIRE( ts2.size() == 10 );
+    }
+
+    SECTION("changes mode while another thread posts") {
+        std::atomic_bool done = false;
+        std::thread poster([&mux, &done]() {
+            for (int i = 0; !done; ++i) {
+                mux->post({4,100+i,0,1,Channel::kColour},{});
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+
+        for (int i = 0; i < 6; ++i) {
+            mux->setConcurrent(i % 2 == 0, 2);
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        }
+        done = true;
+        poster.join();
+        mux->clear();
+
+        // Each stream was posted to by one thread at a time, in order
+        REQUIRE( ts1.size() > 0 );
+        REQUIRE( std::is_sorted(ts1.begin(), ts1.end()) );
+        REQUIRE( std::is_sorted(ts2.begin(), ts2.end()) );
+    }
+}
+
 TEST_CASE("Broadcast enable", "[stream]") {
     std::unique_ptr<Broadcast> mux = std::make_unique<Broadcast>();
     REQUIRE(mux);
@@ -0,0 +1,117 @@
+/** Dispatcher unit test, checks that steady state dispatch does not allocate. */
+
+#include "catch.hpp"
+
+#include <string>
+#include <tuple>
+
+#include <dispatcher.hpp>
+#include <peer.hpp>
+#include <protocol.hpp>
+#include <ftl/protocol.hpp>
+
+#include "mocks/connection.hpp"
+#include "alloc_counter.hpp"
+
+using ftl::net::Dispatcher;
+
+template <typename F>
+static void bind(Dispatcher &d, const std::string &name, F func) {
+    d.bind(name, func,
+        typename ftl::internal::func_kind_info<F>::result_kind(),
+        typename ftl::internal::func_kind_info<F>::args_kind(),
+        typename ftl::internal::func_kind_info<F>::has_peer());
+}
+
+// --- Tests -------------------------------------------------------------------
+
+TEST_CASE("Dispatcher allocations", "[rpc]") {
+    auto p = createMockPeer(0);
+    Dispatcher disp;
+    msgpack::zone z;
+
+    constexpr int kMessages = 1000;
+
+    SECTION("notification by name") {
+        int total = 0;
+        bind(disp, "add", [&total](int a, int b) { total += a + b; });
+
+        auto msg = msgpack::object(std::make_tuple(0, std::string("add"), std::make_tuple(1, 2)), z);
+        disp.dispatch(*p, msg);
+
+        auto allocs = countAllocs([&]() {
+            for (int i = 0; i < kMessages; ++i) disp.dispatch(*p, msg);
+        });
+
+        REQUIRE( total == 3 * (kMessages + 1) );
+        REQUIRE( allocs == 0 );
+    }
+
+    SECTION("notification by method id") {
+        int total = 0;
+        bind(disp, "add", [&total](int a, int b) { total += a + b; });
+
+        auto id = disp.getMethodId("add");
+        REQUIRE( id );
+
+        auto msg = msgpack::object(std::make_tuple(0, *id, std::make_tuple(1, 2)), z);
+        disp.dispatch(*p, msg);
+
+        auto allocs = countAllocs([&]() {
+            for (int i = 0; i < kMessages; ++i) disp.dispatch(*p, msg);
+        });
+
+        REQUIRE( total == 3 * (kMessages + 1) );
+        REQUIRE( allocs == 0 );
+    }
+
+    SECTION("notification by URI name") {
+        // Longer than any small string buffer
+        const std::string uri = "ftl://utu.fi/streams/99/frameset/0/update";
+        int total = 0;
+        bind(disp, uri, [&total](int a, int b) { total += a + b; });
+
+        auto msg = msgpack::object(std::make_tuple(0, uri, std::make_tuple(1, 2)), z);
+        disp.dispatch(*p, msg);
+
+        auto allocs = countAllocs([&]() {
+            for (int i = 0; i < kMessages; ++i) disp.dispatch(*p, msg);
+        });
+
+        REQUIRE( total == 3 * (kMessages + 1) );
+        REQUIRE( allocs == 0 );
+    }
+
+    SECTION("call sends result and reuses zone") {
+        const std::string uri = "ftl://utu.fi/streams/99/frameset/0/values";
+        bind(disp, uri, []() { return std::make_tuple(1, 2.0, true); });
+
+        auto msg = msgpack::object(std::make_tuple(0, uint32_t(42), uri, std::make_tuple()), z);
+        fakedata[0].clear();
+        disp.dispatch(*p, msg);
+
+        // [1, id, error, result]
+        auto res = msgpack::unpack(fakedata[0].data(), fakedata[0].size());
+        std::tuple<uint8_t, uint32_t, msgpack::object, std::tuple<int, double, bool>> response;
+        res.get().convert(response);
+        REQUIRE( std::get<0>(response) == 1 );
+        REQUIRE( std::get<1>(response) == 42 );
+        REQUIRE( std::get<2>(response).is_nil() );
+        REQUIRE( std::get<3>(response) == std::make_tuple(1, 2.0, true) );
+
+        // Responses are written to fakedata, which keeps its capacity
+        const size_t size = fakedata[0].size();
+        auto allocs = countAllocs([&]() {
+            for (int i = 0; i < kMessages; ++i) {
+                fakedata[0].clear();
+                disp.dispatch(*p, msg);
+            }
+        });
+
+        REQUIRE( fakedata[0].size() == size );
+        REQUIRE( allocs == 0 );
+    }
+
+    p.reset();
+    ftl::protocol::reset();
+}
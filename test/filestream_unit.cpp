@@ -2,9 +2,14 @@
 
 #include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <map>
+#include <mutex>
 #include <ftl/protocol/streams.hpp>
 #include <ftl/protocol.hpp>
 #include <ftl/time.hpp>
+#include "../src/streams/filestream.hpp"
+#include "../src/streams/playbackscheduler.hpp"
 
 using ftl::protocol::Channel;
 using ftl::protocol::Codec;
@@ -136,6 +141,55 @@ TEST_CASE("File write and read", "[stream]") {
     }
 }
 
+TEST_CASE("File dispatches packets per frame", "[stream]") {
+    std::string file = "ftl_file_stream_test" + std::to_string(ctr++) + ".ftl";
+    std::string filename = (std::filesystem::temp_directory_path() / file).string();
+
+    // 4 timestamps of 2 frames with 10 channels each, frames interleaved
+    auto writer = ftl::createStream(filename);
+    REQUIRE( writer->begin() );
+
+    auto time = ftl::time::get_time();
+    for (int t = 0; t < 4; ++t) {
+        for (int c = 0; c < 10; ++c) {
+            for (uint8_t f = 0; f < 2; ++f) {
+                REQUIRE( writer->post({5, time + t*50, 0, f, static_cast<Channel>(c)}, {Codec::kAny, 0, 1, 0, 0, {'f'}}) );
+            }
+        }
+    }
+    writer->end();
+
+    auto reader = ftl::getStream(filename);
+
+    std::mutex mtx;
+    std::map<std::pair<int64_t, int>, int> counts;
+    std::vector<int> endframes;
+    std::atomic_int total = 0;
+    std::atomic_int bad = 0;
+    auto h = reader->onPacket([&](const StreamPacket &spkt, const DataPacket &pkt) {
+        std::unique_lock<std::mutex> lk(mtx);
+        auto key = std::make_pair(spkt.timestamp, static_cast<int>(spkt.frame_number));
+        if (spkt.channel == Channel::kEndFrame) {
+            // All packets of the frame arrive before its end frame
+            if (counts[key] != 10 || pkt.packet_count != 11) ++bad;
+            endframes.push_back(spkt.frame_number);
+        } else {
+            ++counts[key];
+            ++total;
+        }
+        return true;
+    });
+    REQUIRE( reader->begin() );
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    reader->end();
+
+    REQUIRE( total == 80 );
+    REQUIRE( bad == 0 );
+    // Short recordings are static, so the last frames are ended too
+    REQUIRE( endframes.size() == 8 );
+}
+
 TEST_CASE("File write fails for bad filename", "[stream]") {
     std::string filename = (std::filesystem::temp_directory_path() / "badfile.exe").string();
     std::ofstream out(filename);
@@ -145,3 +199,592 @@ TEST_CASE("File write fails for bad filename", "[stream]") {
 
     REQUIRE(!writer->begin());
 }
+
+TEST_CASE("File seek using index", "[stream]") {
+    std::string file = "ftl_file_stream_test" + std::to_string(ctr++) + ".ftl";
+    std::string filename = (std::filesystem::temp_directory_path() / file).string();
+
+    // 20 frames, 50ms apart, key frame every 5th
+    auto writer = ftl::createStream(filename);
+    REQUIRE( writer->begin() );
+
+    auto time = ftl::time::get_time();
+    for (uint8_t i = 0; i < 20; ++i) {
+        uint8_t nal = (i % 5 == 0) ? 0x65 : 0x41;
+        REQUIRE( writer->post({5, time + i*50, 0, 0, Channel::kColour}, {Codec::kH264, 0, 1, 0, 0, {0, 0, 1, nal, i}}) );
+    }
+    writer->end();
+
+    SECTION("gives the duration") {
+        auto reader = ftl::getStream(filename);
+        REQUIRE( reader->supportsProperty(ftl::protocol::StreamProperty::kDuration) );
+        REQUIRE( std::any_cast<int64_t>(reader->getProperty(ftl::protocol::StreamProperty::kDuration)) == 950 );
+    }
+
+    SECTION("seeks to the previous key frame") {
+        auto reader = ftl::getStream(filename);
+
+        std::mutex mtx;
+        std::atomic_bool seeked = false;
+        std::vector<int> frames;
+        auto h = reader->onPacket([&](const StreamPacket &spkt, const DataPacket &pkt) {
+            if (spkt.channel == Channel::kEndFrame || !seeked) return true;
+            std::unique_lock<std::mutex> lk(mtx);
+            frames.push_back(pkt.data[4]);
+            return true;
+        });
+        REQUIRE( reader->begin() );
+
+        // Set before the seek, so that the first frame after it is seen.
+        // Frames still in flight from before the seek come first.
+        seeked = true;
+        reader->setProperty(ftl::protocol::StreamProperty::kPosition, int64_t(620));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        reader->end();
+
+        std::unique_lock<std::mutex> lk(mtx);
+        auto after = std::find_if(frames.begin(), frames.end(), [](int f) { return f >= 10; });
+        REQUIRE( after != frames.end() );
+        REQUIRE( *after == 10 );
+    }
+
+    SECTION("reads files without an index") {
+        // Clear the index offset, as written by older versions
+        {
+            std::fstream f(filename, std::ios::in | std::ios::out | std::ios::binary);
+            ftl::protocol::IndexHeader ih;
+            f.seekp(sizeof(ftl::protocol::Header));
+            f.write(reinterpret_cast<const char*>(&ih), sizeof(ih));
+        }
+
+        auto reader = ftl::getStream(filename);
+        REQUIRE( std::any_cast<int64_t>(reader->getProperty(ftl::protocol::StreamProperty::kDuration)) == 0 );
+
+        std::atomic_int count = 0;
+        auto h = reader->onPacket([&count](const StreamPacket &spkt, const DataPacket &pkt) {
+            if (spkt.channel != Channel::kEndFrame) ++count;
+            return true;
+        });
+        REQUIRE( reader->begin() );
+        REQUIRE_THROWS( reader->setProperty(ftl::protocol::StreamProperty::kPosition, int64_t(500)) );
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        reader->end();
+
+        REQUIRE( count > 0 );
+    }
+}
+
+TEST_CASE("File metadata block", "[stream]") {
+    std::string file = "ftl_file_stream_test" + std::to_string(ctr++) + ".ftl";
+    std::string filename = (std::filesystem::temp_directory_path() / file).string();
+
+    auto writer = ftl::createStream(filename);
+    REQUIRE( writer->begin() );
+
+    auto time = ftl::time::get_time();
+    for (uint8_t i = 0; i < 10; ++i) {
+        REQUIRE( writer->post({5, time + i*40, 0, 0, Channel::kColour}, {Codec::kAny, 0, 1, 0, 0, {'f', i}}) );
+        REQUIRE( writer->post({5, time + i*40, 0, 1, Channel::kDepth}, {Codec::kAny, 0, 1, 0, 0, {'f', i}}) );
+    }
+    writer->end();
+
+    SECTION("opens without reading packets") {
+        // Corrupt the packets, only the headers, index and metadata remain
+        {
+            std::fstream f(filename, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(sizeof(ftl::protocol::Header) + sizeof(ftl::protocol::IndexHeader));
+            std::string junk(64, static_cast<char>(0xC1));
+            f.write(junk.data(), junk.size());
+        }
+
+        auto reader = ftl::getStream(filename);
+        REQUIRE( reader->begin() );
+        reader->end();
+
+        REQUIRE( reader->frames().size() == 2 );
+        REQUIRE( reader->channels(ftl::protocol::FrameID(0, 1)).count(Channel::kDepth) == 1 );
+        REQUIRE( std::any_cast<int64_t>(reader->getProperty(ftl::protocol::StreamProperty::kDuration)) == 360 );
+    }
+
+    SECTION("gives the same frames as a scan") {
+        auto reader = ftl::getStream(filename);
+
+        std::atomic_int count = 0;
+        auto h = reader->onPacket([&count](const StreamPacket &spkt, const DataPacket &pkt) {
+            if (spkt.channel != Channel::kEndFrame) ++count;
+            return true;
+        });
+        REQUIRE( reader->begin() );
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+        reader->end();
+
+        REQUIRE( reader->frames().size() == 2 );
+        REQUIRE( count == 20 );
+    }
+}
+
+TEST_CASE("File memory mapped read", "[stream]") {
+    std::string file = "ftl_file_stream_test" + std::to_string(ctr++) + ".ftl";
+    std::string filename = (std::filesystem::temp_directory_path() / file).string();
+
+    auto writer = ftl::createStream(filename);
+    REQUIRE( writer->begin() );
+
+    auto time = ftl::time::get_time();
+    for (uint8_t i = 0; i < 10; ++i) {
+        REQUIRE( writer->post({5, time + i*50, 0, 0, Channel::kColour}, {Codec::kAny, 0, 1, 0, 0, {'f', i}}) );
+    }
+    writer->end();
+
+    SECTION("is only mapped when asked") {
+        ftl::protocol::File reader(filename);
+        REQUIRE( reader.isValid() );
+        REQUIRE( !reader.isMemoryMapped() );
+
+        ftl::protocol::File mapped_reader("file://" + filename + "?mmap=1");
+        REQUIRE( mapped_reader.isValid() );
+        REQUIRE( mapped_reader.isMemoryMapped() );
+    }
+
+    SECTION("stops at the end of a file truncated while reading") {
+        ftl::protocol::File reader(filename);
+        REQUIRE( reader.isValid() );
+
+        ftl::protocol::Packet pkt;
+        REQUIRE( reader.readPacket(pkt) );
+        std::filesystem::resize_file(filename, 0);
+
+        int count = 1;
+        while (reader.readPacket(pkt)) ++count;
+        REQUIRE( count <= 10 );
+    }
+
+    SECTION("reads packet views from the mapping") {
+        ftl::protocol::File reader(filename);
+        reader.setMemoryMapped(true);
+        REQUIRE( reader.isValid() );
+        REQUIRE( reader.isMemoryMapped() );
+
+        ftl::protocol::FilePacketView view;
+        for (uint8_t i = 0; i < 10; ++i) {
+            REQUIRE( reader.readPacket(view) );
+            REQUIRE( view.mapping );
+            REQUIRE( view.pkt.data.size == 2 );
+            REQUIRE( view.pkt.data.data >= view.mapping->data() );
+            REQUIRE( view.pkt.data.data < view.mapping->data() + view.mapping->size() );
+            REQUIRE( view.pkt.data.data[1] == i );
+            REQUIRE( view.spkt.timestamp == time + i*50 );
+        }
+        REQUIRE( !reader.readPacket(view) );
+    }
+
+    SECTION("mapped and streamed reads give the same packets") {
+        for (bool mapped : {true, false}) {
+            ftl::protocol::File reader(filename);
+            reader.setMemoryMapped(mapped);
+            REQUIRE( reader.isValid() );
+            REQUIRE( reader.isMemoryMapped() == mapped );
+
+            for (uint8_t i = 0; i < 10; ++i) {
+                ftl::protocol::Packet pkt;
+                REQUIRE( reader.readPacket(pkt) );
+                REQUIRE( pkt.channel == Channel::kColour );
+                REQUIRE( pkt.data.size() == 2 );
+                REQUIRE( pkt.data[1] == i );
+            }
+        }
+    }
+}
+
+TEST_CASE("File background writing", "[stream]") {
+    std::string file = "ftl_file_stream_test" + std::to_string(ctr++) + ".ftl";
+    std::string filename = (std::filesystem::temp_directory_path() / file).string();
+
+    SECTION("writes all packets with a large buffer") {
+        ftl::protocol::File writer(filename, true);
+        writer.setWriteBuffer(1024*1024);
+        writer.setSyncPolicy(ftl::protocol::File::SyncPolicy::kOnClose);
+        REQUIRE( writer.begin() );
+
+        auto time = ftl::time::get_time();
+        for (uint8_t i = 0; i < 100; ++i) {
+            REQUIRE( writer.post({5, time + i*50, 0, 0, Channel::kColour}, {Codec::kAny, 0, 1, 0, 0, {'f', i}}) );
+        }
+        writer.end();
+        REQUIRE( writer.dropCount() == 0 );
+
+        ftl::protocol::File reader(filename);
+        REQUIRE( reader.isValid() );
+        for (uint8_t i = 0; i < 100; ++i) {
+            ftl::protocol::Packet pkt;
+            REQUIRE( reader.readPacket(pkt) );
+            REQUIRE( pkt.data[1] == i );
+        }
+        REQUIRE( std::any_cast<int64_t>(reader.getProperty(ftl::protocol::StreamProperty::kDuration)) == 99*50 );
+    }
+
+    SECTION("drops and counts packets when buffers are full") {
+        ftl::protocol::File writer(filename, true);
+        writer.setWriteBuffer(1024);
+        REQUIRE( writer.begin() );
+
+        int failed = 0;
+        auto time = ftl::time::get_time();
+        for (int i = 0; i < 1000; ++i) {
+            if (!writer.post({5, time + i, 0, 0, Channel::kColour}, {Codec::kAny, 0, 1, 0, 0, std::vector<uint8_t>(4000)})) {
+                ++failed;
+            }
+        }
+        writer.end();
+        REQUIRE( static_cast<size_t>(failed) == writer.dropCount() );
+        REQUIRE( std::any_cast<int>(writer.getProperty(ftl::protocol::StreamProperty::kDropCount)) == failed );
+
+        ftl::protocol::File reader(filename);
+        REQUIRE( reader.isValid() );
+        int count = 0;
+        ftl::protocol::Packet pkt;
+        while (reader.readPacket(pkt)) ++count;
+        REQUIRE( count + failed == 1000 );
+    }
+}
+
+TEST_CASE("File playback speed", "[stream]") {
+    std::string file = "ftl_file_stream_test" + std::to_string(ctr++) + ".ftl";
+    std::string filename = (std::filesystem::temp_directory_path() / file).string();
+
+    // 2 seconds of recording
+    auto writer = ftl::createStream(filename);
+    REQUIRE( writer->begin() );
+
+    auto time = ftl::time::get_time();
+    for (uint8_t i = 0; i < 40; ++i) {
+        REQUIRE( writer->post({5, time + i*50, 0, 0, Channel::kColour}, {Codec::kAny, 0, 1, 0, 0, {'f', i}}) );
+    }
+    writer->end();
+
+    auto reader = ftl::getStream(filename);
+
+    std::vector<int> frames;
+    auto h = reader->onPacket([&frames](const StreamPacket &spkt, const DataPacket &pkt) {
+        if (spkt.channel != Channel::kEndFrame) frames.push_back(pkt.data[1]);
+        return true;
+    });
+
+    SECTION("plays as fast as possible with speed 0") {
+        reader->setProperty(ftl::protocol::StreamProperty::kSpeed, 0);
+        REQUIRE( std::any_cast<float>(reader->getProperty(ftl::protocol::StreamProperty::kSpeed)) == 0.0f );
+        REQUIRE( reader->begin() );
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        reader->end();
+
+        REQUIRE( frames.size() == 40 );
+        for (int i = 0; i < 40; ++i) REQUIRE( frames[i] == i );
+    }
+
+    SECTION("plays faster with a multiplier") {
+        reader->setProperty(ftl::protocol::StreamProperty::kSpeed, 4.0f);
+        REQUIRE( reader->begin() );
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        reader->end();
+
+        // Around 1.2 seconds of recording, more than real time would give
+        REQUIRE( frames.size() > 10 );
+        REQUIRE( frames.size() < 40 );
+    }
+}
+
+TEST_CASE("File reads only enabled channels", "[stream]") {
+    std::string file = "ftl_file_stream_test" + std::to_string(ctr++) + ".ftl";
+    std::string filename = (std::filesystem::temp_directory_path() / file).string();
+
+    auto writer = ftl::createStream(filename);
+    REQUIRE( writer->begin() );
+
+    auto time = ftl::time::get_time();
+    for (uint8_t i = 0; i < 5; ++i) {
+        for (uint8_t f = 0; f < 2; ++f) {
+            REQUIRE( writer->post({5, time + i*50, 0, f, Channel::kColour}, {Codec::kAny, 0, 1, 0, 0, {'f', i}}) );
+            REQUIRE( writer->post({5, time + i*50, 0, f, Channel::kDepth}, {Codec::kAny, 0, 1, 0, 0, {'f', i}}) );
+        }
+    }
+    writer->end();
+
+    auto reader = ftl::getStream(filename);
+
+    std::mutex mtx;
+    std::vector<std::pair<int, Channel>> received;
+    auto h = reader->onPacket([&](const StreamPacket &spkt, const DataPacket &pkt) {
+        if (spkt.channel == Channel::kEndFrame) return true;
+        std::unique_lock<std::mutex> lk(mtx);
+        received.emplace_back(spkt.frame_number, spkt.channel);
+        return true;
+    });
+
+    SECTION("reads everything when nothing is enabled") {
+        REQUIRE( reader->begin() );
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        reader->end();
+
+        REQUIRE( received.size() == 20 );
+    }
+
+    SECTION("skips channels that are not enabled") {
+        REQUIRE( reader->enable(ftl::protocol::FrameID(0, 1), Channel::kColour) );
+        REQUIRE( reader->begin() );
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        reader->end();
+
+        REQUIRE( received.size() == 5 );
+        for (const auto &r : received) {
+            REQUIRE( r.first == 1 );
+            REQUIRE( r.second == Channel::kColour );
+        }
+    }
+}
+
+TEST_CASE("File block format", "[stream]") {
+    std::string file = "ftl_file_stream_test" + std::to_string(ctr++) + ".ftl";
+    std::string filename = (std::filesystem::temp_directory_path() / file).string();
+
+    // 10 frames of 2 packets, one block per frame
+    {
+        ftl::protocol::File writer(filename, true);
+        writer.setFormatVersion(ftl::protocol::kBlockFTLVersion);
+        REQUIRE( writer.begin() );
+
+        auto time = ftl::time::get_time();
+        for (uint8_t i = 0; i < 10; ++i) {
+            REQUIRE( writer.post({5, time + i*50, 0, 0, Channel::kColour}, {Codec::kAny, 0, 1, 0, 0, {'f', i}}) );
+            REQUIRE( writer.post({5, time + i*50, 0, 0, Channel::kDepth}, {Codec::kAny, 0, 1, 0, 0, {'f', i}}) );
+        }
+        writer.end();
+    }
+
+    SECTION("reads packets from blocks") {
+        for (bool mapped : {true, false}) {
+            ftl::protocol::File reader(filename);
+            reader.setMemoryMapped(mapped);
+            REQUIRE( reader.isValid() );
+            REQUIRE( reader.verify() == 0 );
+            REQUIRE( std::any_cast<int64_t>(reader.getProperty(ftl::protocol::StreamProperty::kDuration)) == 450 );
+
+            ftl::protocol::Packet pkt;
+            for (uint8_t i = 0; i < 20; ++i) {
+                REQUIRE( reader.readPacket(pkt) );
+                REQUIRE( pkt.data[1] == i / 2 );
+            }
+            REQUIRE( !reader.readPacket(pkt) );
+        }
+    }
+
+    SECTION("skips a damaged block") {
+        // Find the third block and damage its packets
+        {
+            std::fstream f(filename, std::ios::in | std::ios::out | std::ios::binary);
+            int64_t pos = sizeof(ftl::protocol::Header) + sizeof(ftl::protocol::IndexHeader);
+            ftl::protocol::BlockHeader bh;
+            for (int i = 0; i < 3; ++i) {
+                f.seekg(pos);
+                f.read(reinterpret_cast<char*>(&bh), sizeof(bh));
+                REQUIRE( bh.magic == ftl::protocol::kBlockMagic );
+                REQUIRE( bh.count == 2 );
+                if (i < 2) pos += sizeof(bh) + bh.size;
+            }
+            f.seekp(pos + sizeof(bh) + 2);
+            f.put('x');
+        }
+
+        for (bool mapped : {true, false}) {
+            ftl::protocol::File reader(filename);
+            reader.setMemoryMapped(mapped);
+            REQUIRE( reader.isValid() );
+            REQUIRE( reader.verify() == 1 );
+
+            std::vector<int> frames;
+            ftl::protocol::Packet pkt;
+            while (reader.readPacket(pkt)) frames.push_back(pkt.data[1]);
+
+            REQUIRE( frames.size() == 18 );
+            REQUIRE( std::count(frames.begin(), frames.end(), 2) == 0 );
+            REQUIRE( frames.back() == 9 );
+        }
+    }
+
+    SECTION("plays back as a stream") {
+        auto reader = ftl::getStream(filename);
+
+        std::atomic_int count = 0;
+        auto h = reader->onPacket([&count](const StreamPacket &spkt, const DataPacket &pkt) {
+            if (spkt.channel != Channel::kEndFrame) ++count;
+            return true;
+        });
+        REQUIRE( reader->begin() );
+        std::this_thread::sleep_for(std::chrono::milliseconds(700));
+        reader->end();
+
+        REQUIRE( count == 20 );
+    }
+}
+
+TEST_CASE("File shared playback scheduler", "[stream]") {
+    std::vector<std::string> filenames;
+    auto time = ftl::time::get_time();
+
+    for (int n = 0; n < 3; ++n) {
+        std::string file = "ftl_file_stream_test" + std::to_string(ctr++) + ".ftl";
+        filenames.push_back((std::filesystem::temp_directory_path() / file).string());
+
+        // Recordings started at different times but with the same frame rate
+        auto writer = ftl::createStream(filenames.back());
+        REQUIRE( writer->begin() );
+        for (uint8_t i = 0; i < 10; ++i) {
+            REQUIRE( writer->post({5, time + n*7 + i*50, 0, 0, Channel::kColour}, {Codec::kAny, 0, 1, 0, 0, {'f', i}}) );
+        }
+        writer->end();
+    }
+
+    std::vector<std::shared_ptr<ftl::protocol::Stream>> readers;
+    std::vector<ftl::Handle> handles;
+    std::mutex mtx;
+    std::vector<std::map<int, int64_t>> stamps(3);
+
+    for (int n = 0; n < 3; ++n) {
+        readers.push_back(ftl::getStream(filenames[n]));
+        handles.push_back(readers.back()->onPacket([&mtx, &stamps, n](const StreamPacket &spkt, const DataPacket &pkt) {
+            if (spkt.channel == Channel::kEndFrame) return true;
+            std::unique_lock<std::mutex> lk(mtx);
+            stamps[n][pkt.data[1]] = spkt.timestamp;
+            return true;
+        }));
+    }
+
+    // Avoid starting across a frame interval boundary
+    while (ftl::time::get_time() % 50 > 20) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    for (auto &r : readers) REQUIRE( r->begin() );
+    REQUIRE( ftl::protocol::PlaybackScheduler::getInstance().size() == 3 );
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(700));
+    for (auto &r : readers) r->end();
+    REQUIRE( ftl::protocol::PlaybackScheduler::getInstance().size() == 0 );
+
+    // Matching frames were given the same timestamps
+    for (int n = 0; n < 3; ++n) REQUIRE( stamps[n].size() == 10 );
+    REQUIRE( stamps[0] == stamps[1] );
+    REQUIRE( stamps[0] == stamps[2] );
+}
+
+TEST_CASE("File segmented recording", "[stream]") {
+    std::string file = "ftl_file_stream_test" + std::to_string(ctr++) + ".ftl";
+    std::string filename = (std::filesystem::temp_directory_path() / file).string();
+    auto segment = [&filename](int n) {
+        std::filesystem::path p(filename);
+        return p.replace_extension(std::to_string(n) + ".ftl").string();
+    };
+
+    // 20 frames, 50ms apart, in segments of 6 frames
+    {
+        ftl::protocol::File writer(filename, true);
+        writer.setWriteBuffer(1024*1024);
+        writer.setSegmentLimits(0, 300);
+        REQUIRE( writer.begin() );
+
+        auto time = ftl::time::get_time();
+        for (uint8_t i = 0; i < 20; ++i) {
+            REQUIRE( writer.post({5, time + i*50, 0, 0, Channel::kColour}, {Codec::kAny, 0, 1, 0, 0, {'f', i}}) );
+        }
+        writer.end();
+    }
+
+    SECTION("writes segments with their own index") {
+        REQUIRE( std::filesystem::exists(segment(3)) );
+        REQUIRE( !std::filesystem::exists(segment(4)) );
+
+        ftl::protocol::File reader(segment(2));
+        REQUIRE( reader.isValid() );
+        REQUIRE( std::any_cast<int64_t>(reader.getProperty(ftl::protocol::StreamProperty::kDuration)) == 250 );
+
+        ftl::protocol::Packet pkt;
+        REQUIRE( reader.readPacket(pkt) );
+        REQUIRE( pkt.data[1] == 12 );
+    }
+
+    SECTION("reads all segments as one recording") {
+        for (bool mapped : {true, false}) {
+            ftl::protocol::File reader(filename);
+            reader.setMemoryMapped(mapped);
+            REQUIRE( reader.isValid() );
+            REQUIRE( std::any_cast<int64_t>(reader.getProperty(ftl::protocol::StreamProperty::kDuration)) == 950 );
+
+            ftl::protocol::Packet pkt;
+            for (uint8_t i = 0; i < 20; ++i) {
+                REQUIRE( reader.readPacket(pkt) );
+                REQUIRE( pkt.data[1] == i );
+            }
+            REQUIRE( !reader.readPacket(pkt) );
+        }
+    }
+
+    SECTION("plays and seeks across segments") {
+        auto reader = ftl::getStream(filename);
+
+        std::mutex mtx;
+        std::atomic_bool seeked = false;
+        std::vector<int> frames;
+        auto h = reader->onPacket([&](const StreamPacket &spkt, const DataPacket &pkt) {
+            if (spkt.channel == Channel::kEndFrame || !seeked) return true;
+            std::unique_lock<std::mutex> lk(mtx);
+            frames.push_back(pkt.data[1]);
+            return true;
+        });
+        reader->setProperty(ftl::protocol::StreamProperty::kSpeed, 0);
+        REQUIRE( reader->begin() );
+
+        // Unthrottled frames follow the seek at once, so start recording
+        // before it. Frames still in flight from before the seek come first.
+        seeked = true;
+        reader->setProperty(ftl::protocol::StreamProperty::kPosition, int64_t(620));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        reader->end();
+
+        std::unique_lock<std::mutex> lk(mtx);
+        REQUIRE( frames.size() >= 8 );
+        const size_t first = frames.size() - 8;
+        for (size_t i = 0; i < 8; ++i) REQUIRE( frames[first + i] == 12 + static_cast<int>(i) );
+    }
+
+    SECTION("removes old segments when recording segments again") {
+        ftl::protocol::File writer(filename, true);
+        writer.setSegmentLimits(0, 300);
+        REQUIRE( writer.begin() );
+        REQUIRE( writer.post({5, ftl::time::get_time(), 0, 0, Channel::kColour}, {Codec::kAny, 0, 1, 0, 0, {'f', 0}}) );
+        writer.end();
+
+        REQUIRE( !std::filesystem::exists(segment(1)) );
+        REQUIRE( !std::filesystem::exists(segment(3)) );
+    }
+
+    SECTION("ignores segment files of another recording") {
+        // Recording without segments leaves files with segment names alone
+        ftl::protocol::File writer(filename, true);
+        REQUIRE( writer.begin() );
+        REQUIRE( writer.post({5, ftl::time::get_time(), 0, 0, Channel::kColour}, {Codec::kAny, 0, 1, 0, 0, {'f', 0}}) );
+        writer.end();
+
+        REQUIRE( std::filesystem::exists(segment(1)) );
+
+        // and does not play them as part of the new recording
+        ftl::protocol::File reader(filename);
+        REQUIRE( reader.isValid() );
+        REQUIRE( std::any_cast<int64_t>(reader.getProperty(ftl::protocol::StreamProperty::kDuration)) == 0 );
+
+        ftl::protocol::Packet pkt;
+        REQUIRE( reader.readPacket(pkt) );
+        REQUIRE( !reader.readPacket(pkt) );
+    }
+}
@@ -7,6 +7,7 @@
 #include "../../src/protocol.hpp"
 #include <ftl/protocol/self.hpp>
 #include <chrono>
+#include <algorithm>
 
 using ftl::net::internal::Socket;
 using ftl::net::internal::SocketConnection;
@@ -16,6 +17,7 @@ using std::chrono::milliseconds;
 // Mock connection, reads/writes from fakedata
 // TODO: use separate in/out data
 std::map<int, std::string> fakedata;
+std::map<int, size_t> fakewritable;
 
 class Connection_Mock : public SocketConnection {
 public:
@@ -56,12 +58,25 @@ public:
 
 	ssize_t writev(const struct iovec *iov, int iovcnt) override {
 		size_t sent = 0;
-		std::stringstream ss;
+		auto &data = fakedata[id_];
 		for (int i = 0; i < iovcnt; i++) {
-			ss << std::string((char*)(iov[i].iov_base), size_t(iov[i].iov_len));
+			data.append((char*)(iov[i].iov_base), size_t(iov[i].iov_len));
 			sent += iov[i].iov_len;
 		}
-		fakedata[id_] += ss.str();
+		return sent;
+	}
+
+	ssize_t try_writev(const struct iovec *iov, int iovcnt) override {
+		if (fakewritable.count(id_) == 0) return writev(iov, iovcnt);
+
+		size_t &writable = fakewritable[id_];
+		size_t sent = 0;
+		for (int i = 0; i < iovcnt && writable > 0; i++) {
+			size_t n = std::min(writable, size_t(iov[i].iov_len));
+			fakedata[id_] += std::string((char*)(iov[i].iov_base), n);
+			writable -= n;
+			sent += n;
+		}
 		return sent;
 	}
 
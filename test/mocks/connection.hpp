@@ -8,6 +8,9 @@ ftl::net::PeerTcpPtr createMockPeer(int c);
 
 extern std::map<int, std::string> fakedata;
 
+// Bytes a mock socket accepts in non-blocking writes, unlimited if not set
+extern std::map<int, size_t> fakewritable;
+
 void send_handshake(ftl::net::PeerTcp &p);
 
 void mockRecv(ftl::net::PeerTcpPtr &p);
@@ -4,6 +4,10 @@
 #include <ftl/protocol/muxer.hpp>
 #include <ftl/protocol/broadcaster.hpp>
 #include <nlohmann/json.hpp>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 using ftl::protocol::Muxer;
 using ftl::protocol::Broadcast;
@@ -249,6 +253,71 @@ TEST_CASE("Muxer read", "[stream]") {
     }
 }
 
+TEST_CASE("Muxer many framesets", "[stream]") {
+    std::unique_ptr<Muxer> mux = std::make_unique<Muxer>();
+    REQUIRE(mux);
+
+    std::vector<std::shared_ptr<Stream>> streams;
+    for (int i = 0; i < 50; ++i) {
+        streams.push_back(std::make_shared<TestStream>());
+        mux->add(streams.back());
+    }
+
+    StreamPacket tspkt = {4,0,0,1,Channel::kColour};
+    auto h = mux->onPacket([&tspkt](const StreamPacket &spkt, const DataPacket &pkt) {
+        tspkt = spkt;
+        return true;
+    });
+
+    for (int i = 0; i < 50; ++i) {
+        REQUIRE( streams[i]->post({4,100+i,0,0,Channel::kColour},{}) );
+        REQUIRE( tspkt.streamID == i );
+        REQUIRE( tspkt.frame_number == 0 );
+    }
+
+    REQUIRE( mux->originStream(FrameID(49, 0)) == streams[49] );
+    REQUIRE( mux->findRemote(FrameID(49, 0)) == FrameID(0, 0) );
+
+    SECTION("fails when all framesets are used") {
+        for (int i = 50; i < 255; ++i) {
+            streams.push_back(std::make_shared<TestStream>());
+            mux->add(streams.back());
+            REQUIRE( streams.back()->post({4,100+i,0,0,Channel::kColour},{}) );
+            REQUIRE( tspkt.streamID == i );
+        }
+
+        auto s = std::make_shared<TestStream>();
+        mux->add(s);
+        REQUIRE_THROWS( mux->findOrCreateLocal(s, FrameID(0, 0)) );
+
+        mux->remove(streams[70]);
+        REQUIRE( mux->findOrCreateLocal(s, FrameID(0, 0)) == FrameID(70, 0) );
+    }
+
+    SECTION("reuses framesets of removed streams") {
+        mux->remove(streams[20]);
+        mux->remove(streams[10]);
+        REQUIRE_THROWS( mux->findRemote(FrameID(10, 0)) );
+
+        auto s1 = std::make_shared<TestStream>();
+        auto s2 = std::make_shared<TestStream>();
+        auto s3 = std::make_shared<TestStream>();
+        mux->add(s1);
+        mux->add(s2);
+        mux->add(s3);
+
+        REQUIRE( s1->post({4,200,0,0,Channel::kColour},{}) );
+        REQUIRE( tspkt.streamID == 10 );
+        REQUIRE( s2->post({4,200,0,0,Channel::kColour},{}) );
+        REQUIRE( tspkt.streamID == 20 );
+        REQUIRE( s3->post({4,200,0,0,Channel::kColour},{}) );
+        REQUIRE( tspkt.streamID == 50 );
+
+        REQUIRE( mux->originStream(FrameID(10, 0)) == s1 );
+        REQUIRE( mux->originStream(FrameID(11, 0)) == streams[11] );
+    }
+}
+
 TEST_CASE("Muxer read multi-frameset", "[stream]") {
     std::unique_ptr<Muxer> mux = std::make_unique<Muxer>();
     REQUIRE(mux);
@@ -792,6 +861,62 @@ TEST_CASE("Muxer mappings", "[stream]") {
         auto foundS2 = mux->findStream("ftl://myuri3");
         REQUIRE( foundS2 == nullptr );
     }
+
+    SECTION("removes mappings with the stream") {
+        std::shared_ptr<Stream> s1 = std::make_shared<TestStream>("ftl://myuri1");
+        REQUIRE(s1);
+        std::shared_ptr<Stream> s2 = std::make_shared<TestStream>("ftl://myuri2");
+        REQUIRE(s2);
+
+        mux->add(s1,1);
+        mux->add(s2,1);
+
+        s1->seen(FrameID(0, 0), Channel::kEndFrame);
+        s2->seen(FrameID(0, 0), Channel::kEndFrame);
+
+        mux->remove(s1);
+
+        REQUIRE_THROWS( mux->findRemote(FrameID(1, 0)) );
+        REQUIRE( mux->findRemote(FrameID(1, 1)).frameset() == 0 );
+        REQUIRE( mux->findStream("ftl://myuri1") == nullptr );
+        REQUIRE( mux->findLocal("ftl://myuri2", FrameID(0, 0)) == FrameID(1, 1) );
+    }
+
+    SECTION("consistent mappings with concurrent streams") {
+        std::vector<std::shared_ptr<Stream>> streams;
+        for (int i = 0; i < 4; ++i) {
+            streams.push_back(std::make_shared<TestStream>());
+            mux->add(streams.back());
+        }
+
+        // Timestamp identifies the stream and source, each must keep one local ID
+        std::array<std::atomic_int, 4 * 8> locals;
+        for (auto &l : locals) l = -1;
+        std::atomic_int bad = 0;
+
+        auto h = mux->onPacket([&locals, &bad](const StreamPacket &spkt, const DataPacket &pkt) {
+            int expected = -1;
+            const int local = FrameID(spkt.streamID, spkt.frame_number);
+            if (!locals[spkt.timestamp].compare_exchange_strong(expected, local) && expected != local) ++bad;
+            return true;
+        });
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([i, &streams]() {
+                for (int n = 0; n < 1000; ++n) {
+                    const uint8_t source = n % 8;
+                    streams[i]->post({4, i * 8 + source, 0, source, Channel::kColour}, {});
+                }
+            });
+        }
+        for (auto &t : threads) t.join();
+
+        REQUIRE( bad == 0 );
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE( mux->findRemote(FrameID(locals[i * 8 + 3].load())).source() == 3 );
+        }
+    }
 }
 
 TEST_CASE("Muxer requests", "[stream]") {
@@ -8,6 +8,7 @@
 
 #include <thread>
 #include <chrono>
+#include <set>
 
 #include "../src/protocol/connection.hpp"
 #include "../src/protocol/tcp.hpp"
@@ -36,7 +37,10 @@ static float peer_send(ftl::net::PeerBase* p, const std::vector<DTYPE>& data, in
 	size_t bytes = data.size() * sizeof(DTYPE);
 
 	for (int i = 0; i < cnt; i++) {
-		p->send("recv_data", data);
+		// Outgoing queue full, wait for it to drain
+		while (p->send("recv_data", data) == PeerBase::kSendWouldBlock) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
 		bytes_sent += bytes;
 	}
 
@@ -98,4 +102,122 @@ TEST_CASE("throughput", "[net]") {
 		auto r = peer_send(p.get(), data_test, COUNT);
 		REQUIRE(r > 1000);
 	}
+
+	SECTION("TCP throughput (poll)") {
+		net_server->setIOBackend(IOBackend::kPoll);
+		net_client->setIOBackend(IOBackend::kPoll);
+		REQUIRE(net_client->getIOBackend() == IOBackend::kPoll);
+
+		LOG(INFO) << "connecting to " << uri.to_string() << " (poll)";
+		auto p = net_client->connect(uri);
+
+		while(!p->isConnected()) { std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
+
+		auto r = peer_send(p.get(), data_test, COUNT);
+		REQUIRE(r > 1000);
+	}
+}
+
+TEST_CASE("multiple I/O threads", "[net]") {
+	auto net_server = std::make_unique<Universe>();
+	net_server->setLocalID(ftl::UUID());
+	net_server->setIOThreads(2);
+	REQUIRE(net_server->getIOThreads() == 2);
+
+	std::atomic_int calls = 0;
+	net_server->bind("test_call", [&calls](){ ++calls; });
+
+	net_server->listen(ftl::URI("tcp://localhost:0"));
+	auto server_uri = ftl::URI("tcp://localhost:" + std::to_string(net_server->getListeningURIs()[0].getPort()));
+
+	auto net_client1 = std::make_unique<Universe>();
+	net_client1->setLocalID(ftl::UUID());
+	auto net_client2 = std::make_unique<Universe>();
+	net_client2->setLocalID(ftl::UUID());
+
+	auto p1 = net_client1->connect(server_uri);
+	auto p2 = net_client2->connect(server_uri);
+	REQUIRE(p1->waitConnection(5));
+	REQUIRE(p2->waitConnection(5));
+	REQUIRE(net_server->waitConnections(5) == 2);
+
+	// Accepted connections are spread over both threads
+	std::set<int> threads;
+	for (const auto &p : net_server->getPeers()) threads.insert(p->ioThread());
+	REQUIRE(threads.size() == 2);
+
+	REQUIRE_THROWS(net_server->setIOThreads(1));
+
+	p1->send("test_call");
+	p2->send("test_call");
+
+	for (int i = 0; i < 50 && calls < 2; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	REQUIRE(calls == 2);
+
+	net_client1->shutdown();
+	net_client2->shutdown();
+	net_server->shutdown();
+}
+
+static std::atomic_int small_recv_ = 0;
+
+static void recv_small(int) {
+	++small_recv_;
+}
+
+static float small_send(ftl::net::PeerBase* p, int cnt, ftl::net::SendFlags flags) {
+	small_recv_ = 0;
+	auto t_start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < cnt; i++) {
+		while (p->send(flags, "recv_small", i) == PeerBase::kSendWouldBlock) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	// Not delayed, flushes anything held back
+	p->send("recv_small", cnt);
+
+	for (int i = 0; i < 10000 && small_recv_ < cnt + 1; i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	REQUIRE(small_recv_ == cnt + 1);
+
+	float ms = std::chrono::duration_cast<std::chrono::milliseconds>
+					(std::chrono::steady_clock::now() - t_start).count();
+	float rate = float(cnt) / std::max(ms, 1.0f) * 1000.0f;
+
+	LOG(INFO) << cnt << " messages in " << ms << " ms, " << rate << " messages/s";
+	return rate;
+}
+
+TEST_CASE("many small messages", "[net]") {
+	constexpr int kSmallCount = 100000;
+
+	auto net_server = std::make_unique<Universe>();
+	net_server->setLocalID(ftl::UUID());
+	auto net_client = std::make_unique<Universe>();
+	net_client->setLocalID(ftl::UUID());
+
+	net_server->bind("recv_small", recv_small);
+	net_server->listen(ftl::URI("tcp://localhost:0"));
+	auto server_uri = ftl::URI("tcp://localhost:" + std::to_string(net_server->getListeningURIs()[0].getPort()));
+
+	auto p = net_client->connect(server_uri);
+	REQUIRE(p->waitConnection(5));
+
+	SECTION("one write per message") {
+		auto r = small_send(p.get(), kSmallCount, ftl::net::SendFlags::NONE);
+		REQUIRE(r > 0);
+	}
+
+	SECTION("coalesced with DELAY") {
+		auto r = small_send(p.get(), kSmallCount, ftl::net::SendFlags::DELAY);
+		REQUIRE(r > 0);
+	}
+
+	SECTION("coalesced without window") {
+		net_client->setCoalesceWindow(0);
+		auto r = small_send(p.get(), kSmallCount, ftl::net::SendFlags::DELAY);
+		REQUIRE(r > 0);
+	}
 }
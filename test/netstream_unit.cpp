@@ -12,6 +12,7 @@
 #include "../src/streams/netstream.hpp"
 #include "../src/streams/packetMsgpack.hpp"
 #include "../src/uuidMSGPACK.hpp"
+#include "../src/protocol.hpp"
 #include "mocks/connection.hpp"
 
 using ftl::protocol::FrameID;
@@ -233,6 +234,49 @@ TEST_CASE("Net stream sending requests") {
         REQUIRE( (s1->lastSpkt.flags & ftl::protocol::kFlagRequest) > 0 );
     }
 
+    SECTION("sends repeat requests - high frameset") {
+        auto s1 = std::make_shared<MockNetStream>("ftl://mystream", ftl::getSelf()->getUniverse(), false);
+
+        // Thread to provide response to otherwise blocking call
+        std::thread thr([&p]() {
+            auto z = std::make_unique<msgpack::zone>();
+            provideResponses(p, 0, {
+                {false, "find_stream", packResponse(*z, ftl::UUIDMSGPACK(p->id()))},
+                {true, "enable_stream", {}},
+            });
+        });
+
+        s1->setProperty(StreamProperty::kRequestSize, 10);
+
+        REQUIRE( s1->begin() );
+
+        s1->forceSeen(FrameID(200, 0), Channel::kColour);
+        REQUIRE( s1->enable(FrameID(200, 0), Channel::kColour));
+
+        ftl::protocol::StreamPacketMSGPACK spkt;
+        ftl::protocol::PacketMSGPACK pkt;
+        spkt.streamID = 200;
+        spkt.frame_number = 0;
+        spkt.channel = Channel::kEndFrame;
+
+        thr.join();
+
+        s1->lastSpkt.channel = Channel::kNone;
+
+        for (int i=0; i<20; ++i) {
+            spkt.timestamp = i;
+            writeNotification(0, "ftl://mystream", std::make_tuple(0, spkt, pkt));
+            p->recv();
+            while (p->jobs() > 0) sleep_for(milliseconds(1));
+        }
+
+        while (s1->postCount < 4) sleep_for(milliseconds(10));
+
+        REQUIRE( s1->lastSpkt.streamID == 200 );
+        REQUIRE( s1->lastSpkt.channel == Channel::kColour );
+        REQUIRE( (s1->lastSpkt.flags & ftl::protocol::kFlagRequest) > 0 );
+    }
+
     SECTION("sends repeat requests - multi frame") {
         auto s1 = std::make_shared<MockNetStream>("ftl://mystream", ftl::getSelf()->getUniverse(), false);
         
@@ -369,6 +413,104 @@ TEST_CASE("Net stream sending requests") {
     ftl::protocol::reset();
 }
 
+TEST_CASE("Net stream broadcasts to several clients") {
+    auto p1 = createMockPeer(1);
+    auto p2 = createMockPeer(2);
+    auto p3 = createMockPeer(3);
+
+    auto s1 = std::make_shared<MockNetStream>("ftl://mystream", ftl::getSelf()->getUniverse(), true);
+    REQUIRE( s1->begin() );
+
+    // Two peers request colour for the same frame, the third only depth
+    ftl::protocol::StreamPacketMSGPACK req;
+    ftl::protocol::PacketMSGPACK reqpkt;
+    req.streamID = 1;
+    req.frame_number = 1;
+    req.channel = Channel::kColour;
+    req.flags = ftl::protocol::kFlagRequest;
+    reqpkt.frame_count = 10;
+
+    writeNotification(1, "ftl://mystream", std::make_tuple(0, req, reqpkt));
+    p1->recv();
+    writeNotification(2, "ftl://mystream", std::make_tuple(0, req, reqpkt));
+    p2->recv();
+    req.channel = Channel::kDepth;
+    writeNotification(3, "ftl://mystream", std::make_tuple(0, req, reqpkt));
+    p3->recv();
+    while (p1->jobs() > 0 || p2->jobs() > 0 || p3->jobs() > 0) sleep_for(milliseconds(1));
+
+    fakedata[1] = "";
+    fakedata[2] = "";
+    fakedata[3] = "";
+    ftl::protocol::Net::getStatistics();
+
+    StreamPacket spkt;
+    spkt.timestamp = 100;
+    spkt.streamID = 1;
+    spkt.frame_number = 1;
+    spkt.channel = Channel::kColour;
+    DataPacket pkt;
+    pkt.frame_count = 1;
+    pkt.data.resize(1000, 7);
+
+    REQUIRE( s1->post(spkt, pkt) );
+
+    REQUIRE( fakedata[1].size() > pkt.data.size() );
+    REQUIRE( fakedata[1] == fakedata[2] );
+    REQUIRE( fakedata[3].size() > 0 );
+    REQUIRE( fakedata[3].size() < pkt.data.size() );
+
+    auto [name, value] = readResponse<std::tuple<int16_t, ftl::protocol::StreamPacketMSGPACK, ftl::protocol::PacketMSGPACK>>(2);
+    REQUIRE( name == "ftl://mystream" );
+    REQUIRE( std::get<2>(value).data == pkt.data );
+
+    // Encoded once with data and once stripped, for three clients
+    auto stats = ftl::protocol::Net::getStatistics();
+    REQUIRE( stats.encodes == 2 );
+
+    // A second post encodes again, it does not reuse the first
+    REQUIRE( s1->post(spkt, pkt) );
+    REQUIRE( ftl::protocol::Net::getStatistics().encodes == 2 );
+
+    // The second client supports method ids and gives one for the stream
+    {
+        ftl::UUID id;
+        std::stringstream buf;
+        msgpack::pack(buf, std::make_tuple(
+            ftl::net::kFeatures,
+            std::string("__handshake__"),
+            std::make_tuple(ftl::net::kMagic, ftl::net::kVersion, ftl::UUIDMSGPACK(id))));
+        fakedata[2] = buf.str();
+        p2->recv();
+        while (p2->jobs() > 0) sleep_for(milliseconds(1));
+        writeNotification(2, "__method_id__", std::make_tuple(std::string("ftl://mystream"), uint32_t(9)));
+        p2->recv();
+        while (p2->jobs() > 0) sleep_for(milliseconds(1));
+    }
+
+    fakedata[1] = "";
+    fakedata[2] = "";
+    fakedata[3] = "";
+    REQUIRE( s1->post(spkt, pkt) );
+
+    // It is sent its own encoding, the other colour client the named one
+    REQUIRE( ftl::protocol::Net::getStatistics().encodes == 3 );
+    REQUIRE( fakedata[1] != fakedata[2] );
+    {
+        auto msg = msgpack::unpack(fakedata[2].data(), fakedata[2].size());
+        std::tuple<uint8_t, uint32_t, std::tuple<int16_t, ftl::protocol::StreamPacketMSGPACK, ftl::protocol::PacketMSGPACK>> notif;
+        msg.get().convert(notif);
+        REQUIRE( std::get<1>(notif) == 9 );
+        REQUIRE( std::get<2>(std::get<2>(notif)).data == pkt.data );
+    }
+
+    s1.reset();
+    p1.reset();
+    p2.reset();
+    p3.reset();
+    ftl::protocol::reset();
+}
+
 TEST_CASE("Net stream can see received data") {
     auto p = createMockPeer(0);
     fakedata[0] = "";
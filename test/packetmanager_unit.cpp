@@ -221,3 +221,123 @@ TEST_CASE( "Overflow the buffer" ) {
 
     REQUIRE(count == 96 + 95 + 2);
 }
+
+TEST_CASE( "PacketManager reorder window" ) {
+    std::vector<int64_t> times;
+    auto cb = [&times](const PacketPair &pp) {
+        times.push_back(pp.first.timestamp);
+    };
+
+    SECTION("skips the incomplete frame when full") {
+        PacketManager mgr(4, 4, ftl::ReorderPolicy::kSkipFrame);
+
+        PacketPair p;
+        p = makePair(500, Channel::kColour);
+        mgr.submit(p, cb);
+
+        for (int i = 0; i < 4; ++i) {
+            p = makePair(501, Channel::kColour);
+            mgr.submit(p, cb);
+        }
+
+        REQUIRE(times.size() == 1);
+        REQUIRE(mgr.dropCount() == 0);
+
+        p = makePair(502, Channel::kColour);
+        mgr.submit(p, cb);
+
+        REQUIRE(times.size() == 5);
+        REQUIRE(times[4] == 501);
+        REQUIRE(mgr.dropCount() == 1);
+
+        p = makePair(501, Channel::kEndFrame);
+        p.second.packet_count = 5;
+        mgr.submit(p, cb);
+
+        REQUIRE(times.size() == 7);
+        REQUIRE(times[5] == 501);
+        REQUIRE(times[6] == 502);
+    }
+
+    SECTION("drops the newest packet when full") {
+        PacketManager mgr(4, 4, ftl::ReorderPolicy::kDropNewest);
+
+        PacketPair p;
+        p = makePair(600, Channel::kColour);
+        mgr.submit(p, cb);
+
+        for (int i = 0; i < 6; ++i) {
+            p = makePair(601, Channel::kColour);
+            mgr.submit(p, cb);
+        }
+
+        REQUIRE(times.size() == 1);
+        REQUIRE(mgr.dropCount() == 2);
+
+        p = makePair(600, Channel::kEndFrame);
+        p.second.packet_count = 2;
+        mgr.submit(p, cb);
+
+        REQUIRE(times.size() == 6);
+        REQUIRE(times[5] == 601);
+    }
+
+    SECTION("gives up a frame with a lost packet when full") {
+        PacketManager mgr(4, 2, ftl::ReorderPolicy::kDropNewest);
+
+        // The second colour packet of frame 800 never arrives
+        PacketPair p;
+        p = makePair(800, Channel::kColour);
+        mgr.submit(p, cb);
+        p = makePair(800, Channel::kEndFrame);
+        p.second.packet_count = 3;
+        mgr.submit(p, cb);
+
+        for (int i = 0; i < 4; ++i) {
+            p = makePair(801, Channel::kColour);
+            mgr.submit(p, cb);
+        }
+
+        p = makePair(801, Channel::kEndFrame);
+        p.second.packet_count = 5;
+        mgr.submit(p, cb);
+        p = makePair(802, Channel::kEndFrame);
+        p.second.packet_count = 1;
+        mgr.submit(p, cb);
+
+        REQUIRE(times.size() == 2);
+        REQUIRE(mgr.dropCount() == 2);
+
+        p = makePair(803, Channel::kEndFrame);
+        p.second.packet_count = 1;
+        mgr.submit(p, cb);
+
+        REQUIRE(times.size() == 6);
+        REQUIRE(times[5] == 801);
+        REQUIRE(mgr.dropCount() == 3);
+    }
+
+    SECTION("gives up after the configured number of frames") {
+        PacketManager mgr;
+        mgr.setWindow(10, 1);
+
+        PacketPair p;
+        p = makePair(700, Channel::kColour);
+        mgr.submit(p, cb);
+
+        p = makePair(701, Channel::kEndFrame);
+        p.second.packet_count = 1;
+        mgr.submit(p, cb);
+
+        REQUIRE(times.size() == 1);
+
+        p = makePair(702, Channel::kEndFrame);
+        p.second.packet_count = 1;
+        mgr.submit(p, cb);
+
+        REQUIRE(times.size() == 3);
+        REQUIRE(times[1] == 701);
+        REQUIRE(times[2] == 702);
+        REQUIRE(mgr.dropCount() == 1);
+    }
+}
@@ -13,6 +13,7 @@
 #include <sstream>
 
 #include <peer.hpp>
+#include <byteView.hpp>
 #include <protocol.hpp>
 #include <ftl/protocol.hpp>
 #include <ftl/protocol/error.hpp>
@@ -261,6 +262,21 @@ TEST_CASE("Peer::bind()", "[rpc]") {
         REQUIRE( (done == "world") );
     }
 
+    SECTION("borrowed binary argument") {
+        std::vector<uint8_t> done;
+        
+        s->bind("hello", [&](int a, const ftl::net::ByteView &b) {
+            done.assign(b.begin(), b.end());
+        });
+
+        std::vector<uint8_t> data = {1, 2, 3, 4, 5};
+        s->send("hello", 55, data);
+        s->recv(); // Force it to read the fake send...
+        sleep_for(milliseconds(50));
+        
+        REQUIRE( (done == data) );
+    }
+
     SECTION("int return value") {		
         int done = 0;
         
@@ -300,6 +316,69 @@ TEST_CASE("Peer::bind()", "[rpc]") {
     ftl::protocol::reset();
 }
 
+// Handshake from a peer that supports method ids
+static void send_handshake_features(int c) {
+    ftl::UUID id;
+    auto msg = std::make_tuple(
+        ftl::net::kFeatures,
+        std::string("__handshake__"),
+        std::make_tuple(ftl::net::kMagic, ftl::net::kVersion, ftl::UUIDMSGPACK(id)));
+    std::stringstream buf;
+    msgpack::pack(buf, msg);
+    fakedata[c] = buf.str();
+}
+
+TEST_CASE("Peer method ids", "[rpc]") {
+    int c = ctr_++;
+    auto s = createMockPeer(c);
+    send_handshake_features(c);
+    s->recv();
+    sleep_for(milliseconds(50));
+    REQUIRE( s->status() == NodeStatus::kConnected );
+
+    SECTION("gives an id to a method called by name") {
+        int done = 0;
+        s->bind("hello", [&](int a) {
+            done = a;
+        });
+
+        writeNotification(c, "hello", std::make_tuple(55));
+        s->recv();
+        sleep_for(milliseconds(50));
+        REQUIRE( (done == 55) );
+
+        auto [name, value] = readResponse<tuple<std::string, uint32_t>>(c);
+        REQUIRE( (name == "__method_id__") );
+        REQUIRE( (get<0>(value) == "hello") );
+
+        // Remote now calls with the id
+        std::stringstream buf;
+        msgpack::pack(buf, std::make_tuple(0, get<1>(value), std::make_tuple(66)));
+        fakedata[c] = buf.str();
+        s->recv();
+        sleep_for(milliseconds(50));
+        REQUIRE( (done == 66) );
+    }
+
+    SECTION("sends with the id given by remote") {
+        writeNotification(c, "__method_id__", std::make_tuple(std::string("dummy"), uint32_t(7)));
+        s->recv();
+        sleep_for(milliseconds(50));
+
+        fakedata[c] = "";
+        s->send("dummy", 5);
+
+        auto msg = msgpack::unpack(fakedata[c].data(), fakedata[c].size());
+        std::tuple<uint8_t, uint32_t, tuple<int>> req;
+        msg.get().convert(req);
+        REQUIRE( (get<1>(req) == 7) );
+        REQUIRE( (get<0>(get<2>(req)) == 5) );
+    }
+
+    s.reset();
+    ftl::protocol::reset();
+}
+
 TEST_CASE("Socket::send()", "[io]") {
     int c = ctr_++;
     auto s = createMockPeer(c);
@@ -360,3 +439,90 @@ TEST_CASE("Socket::send()", "[io]") {
     s.reset();
     ftl::protocol::reset();
 }
+
+// Packs only the bin header, bytes follow as payload
+struct BinHeader {
+    uint32_t size;
+
+    template <typename Packer>
+    void msgpack_pack(Packer &pk) const { pk.pack_bin(size); }
+};
+
+TEST_CASE("Socket::sendWithPayload()", "[io]") {
+    int c = ctr_++;
+    auto s = createMockPeer(c);
+    sleep_for(milliseconds(50));
+    fakedata[c] = "";
+
+    std::vector<uint8_t> payload(1000);
+    for (size_t i = 0; i < payload.size(); i++) payload[i] = uint8_t(i);
+
+    SECTION("payload is written after the header") {
+        REQUIRE( s->sendWithPayload(ftl::net::SendFlags::NONE, payload.data(), payload.size(),
+            "dummy", 5, BinHeader{uint32_t(payload.size())}) == PeerTcp::kSendOk );
+
+        auto [name, value] = readResponse<tuple<int, std::vector<uint8_t>>>(c);
+        REQUIRE( (name == "dummy") );
+        REQUIRE( (get<0>(value) == 5) );
+        REQUIRE( (get<1>(value) == payload) );
+    }
+
+    SECTION("payload is copied when partially written") {
+        fakewritable[c] = 10;
+        REQUIRE( s->sendWithPayload(ftl::net::SendFlags::NONE, payload.data(), payload.size(),
+            "dummy", 5, BinHeader{uint32_t(payload.size())}) == PeerTcp::kSendOk );
+        REQUIRE( s->pendingWriteCals() == 1 );
+
+        // Caller may reuse its memory once the call returns
+        auto expected = payload;
+        std::fill(payload.begin(), payload.end(), 0);
+
+        fakewritable[c] = 1024*1024;
+        REQUIRE( s->send("dummy", 6) == PeerTcp::kSendOk );
+        REQUIRE( s->pendingWriteCals() == 0 );
+
+        auto [name, value] = readResponse<tuple<int, std::vector<uint8_t>>>(c);
+        REQUIRE( (name == "dummy") );
+        REQUIRE( (get<1>(value) == expected) );
+        fakewritable.erase(c);
+    }
+
+    s.reset();
+    ftl::protocol::reset();
+}
+
+TEST_CASE("Socket::send() queue", "[io]") {
+    int c = ctr_++;
+    auto s = createMockPeer(c);
+    sleep_for(milliseconds(50));
+    fakedata[c] = "";
+
+    // Socket buffer full
+    fakewritable[c] = 0;
+
+    REQUIRE( s->send("dummy", 607) == PeerTcp::kSendOk );
+    REQUIRE( fakedata[c].size() == 0 );
+    REQUIRE( s->pendingOutgoing() > 0 );
+    REQUIRE( s->pendingWriteCals() == 1 );
+
+    SECTION("drops when queue limit reached") {
+        s->setMaxPendingBytes(s->pendingOutgoing());
+        REQUIRE( s->send("dummy", 608) == PeerTcp::kSendWouldBlock );
+        REQUIRE( s->pendingWriteCals() == 1 );
+    }
+
+    SECTION("queue is written in order once writable") {
+        fakewritable[c] = 1024*1024;
+        REQUIRE( s->send("dummy", 608) == PeerTcp::kSendOk );
+        REQUIRE( s->pendingOutgoing() == 0 );
+        REQUIRE( s->pendingWriteCals() == 0 );
+
+        auto [name, value] = readResponse<tuple<int>>(c);
+        REQUIRE( (name == "dummy") );
+        REQUIRE( (get<0>(value) == 607) );
+    }
+
+    fakewritable.erase(c);
+    s.reset();
+    ftl::protocol::reset();
+}
@@ -0,0 +1,111 @@
+#include "catch.hpp"
+
+#include <ftl/protocol/streams.hpp>
+#include <ftl/exception.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using ftl::protocol::Stream;
+using ftl::protocol::Channel;
+using ftl::protocol::ChannelSet;
+using ftl::protocol::FrameID;
+
+class TestStream : public ftl::protocol::Stream {
+    public:
+    TestStream() {}
+    ~TestStream() {}
+
+    bool post(const ftl::protocol::StreamPacket &spkt, const ftl::protocol::DataPacket &pkt) {
+        seen(FrameID(spkt.streamID, spkt.frame_number), spkt.channel);
+        trigger(spkt, pkt);
+        return true;
+    }
+
+    bool begin() override { return true; }
+    bool end() override { return true; }
+    bool active() override { return true; }
+
+    void setProperty(ftl::protocol::StreamProperty opt, std::any value) override {}
+    std::any getProperty(ftl::protocol::StreamProperty opt) override { return 0; }
+    bool supportsProperty(ftl::protocol::StreamProperty opt) override { return true; }
+};
+
+TEST_CASE("Stream frame state") {
+    TestStream s;
+
+    SECTION("frames become available when seen") {
+        REQUIRE( !s.available(FrameID(0, 0)) );
+        REQUIRE( s.size() == 0 );
+
+        s.seen(FrameID(0, 0), Channel::kColour);
+        s.seen(FrameID(255, 255), Channel::kColour);
+
+        REQUIRE( s.available(FrameID(0, 0)) );
+        REQUIRE( s.available(FrameID(255, 255)) );
+        REQUIRE( !s.available(FrameID(255, 254)) );
+        REQUIRE( s.size() == 2 );
+
+        auto frames = s.frames();
+        REQUIRE( frames.size() == 2 );
+        REQUIRE( frames.count(FrameID(255, 255)) == 1 );
+    }
+
+    SECTION("enables frames and channels") {
+        s.enable(FrameID(1, 2), Channel::kDepth);
+        s.enable(FrameID(3, 0));
+
+        REQUIRE( s.enabled(FrameID(1, 2)) );
+        REQUIRE( s.enabled(FrameID(1, 2), Channel::kDepth) );
+        REQUIRE( !s.enabled(FrameID(1, 2), Channel::kColour) );
+        REQUIRE( s.enabled().size() == 2 );
+        REQUIRE( s.enabled(1).size() == 1 );
+
+        s.disable(FrameID(1, 2), Channel::kDepth);
+        REQUIRE( !s.enabled(FrameID(1, 2)) );
+        REQUIRE( s.enabled().size() == 1 );
+    }
+
+    SECTION("reset forgets all frames") {
+        s.enable(FrameID(1, 2), Channel::kDepth);
+        s.seen(FrameID(1, 2), Channel::kCalibration);
+        s.reset();
+
+        REQUIRE( s.size() == 0 );
+        REQUIRE( !s.available(FrameID(1, 2)) );
+        REQUIRE( !s.enabled(FrameID(1, 2)) );
+        REQUIRE( s.frames().size() == 0 );
+
+        s.seen(FrameID(1, 2), Channel::kColour);
+        REQUIRE( s.available(FrameID(1, 2)) );
+        REQUIRE( !s.available(FrameID(1, 2), Channel::kCalibration) );
+        REQUIRE( s.size() == 1 );
+    }
+
+    SECTION("rejects framesets out of range") {
+        REQUIRE( !s.available(FrameID(256, 0)) );
+        REQUIRE_THROWS( s.enable(FrameID(256, 0)) );
+    }
+
+    SECTION("seen from many threads") {
+        std::atomic_int count = 0;
+        auto h = s.onAvailable([&count](FrameID id, Channel c) {
+            ++count;
+            return true;
+        });
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&s]() {
+                for (int i = 0; i < 1000; ++i) {
+                    s.seen(FrameID(i % 10, i % 7), Channel::kCalibration);
+                }
+            });
+        }
+        for (auto &t : threads) t.join();
+
+        REQUIRE( s.size() == 70 );
+        REQUIRE( count >= 70 );
+        REQUIRE( s.available(FrameID(9, 6), Channel::kCalibration) );
+    }
+}
@@ -0,0 +1,206 @@
+/** Thread pool unit test and submission contention benchmark. */
+
+#include "catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#define LOGURU_REPLACE_GLOG 1
+#include <loguru.hpp>
+#include <ftl/threadpool.hpp>
+
+#include "alloc_counter.hpp"
+
+using ftl::ThreadPool;
+using std::this_thread::sleep_for;
+using std::chrono::milliseconds;
+
+static void wait_for(const std::atomic_int &count, int value) {
+    for (int i = 0; i < 500 && count < value; ++i) sleep_for(milliseconds(10));
+}
+
+// --- Tests -------------------------------------------------------------------
+
+TEST_CASE("ThreadPool::push()", "[pool]") {
+    ThreadPool pool(4);
+
+    SECTION("returns a result") {
+        auto f = pool.push([](int id) { return 42; });
+        REQUIRE( f.get() == 42 );
+    }
+
+    SECTION("binds extra arguments") {
+        auto f = pool.push([](int id, int a, int b) { return a + b; }, 5, 6);
+        REQUIRE( f.get() == 11 );
+    }
+
+    SECTION("passes the worker id") {
+        auto f = pool.push([](int id) { return id; });
+        int id = f.get();
+        REQUIRE( id >= 0 );
+        REQUIRE( id < 4 );
+    }
+
+    SECTION("forwards exceptions to the future") {
+        auto f = pool.push([](int id) -> int { throw std::runtime_error("fail"); });
+        REQUIRE_THROWS( f.get() );
+    }
+}
+
+TEST_CASE("ThreadPool::post()", "[pool]") {
+    ThreadPool pool(4);
+    std::atomic_int count = 0;
+
+    SECTION("runs all jobs") {
+        for (int i = 0; i < 10000; ++i) {
+            pool.post([&count](int id) { ++count; });
+        }
+        wait_for(count, 10000);
+        REQUIRE( count == 10000 );
+    }
+
+    SECTION("runs jobs posted from a worker") {
+        for (int i = 0; i < 100; ++i) {
+            pool.post([&pool, &count](int id) {
+                for (int j = 0; j < 100; ++j) pool.post([&count](int id) { ++count; });
+            });
+        }
+        wait_for(count, 10000);
+        REQUIRE( count == 10000 );
+    }
+
+    SECTION("spills when worker queues are full") {
+        std::atomic_bool release = false;
+        for (int i = 0; i < 4; ++i) {
+            pool.post([&release](int id) { while (!release) sleep_for(milliseconds(1)); });
+        }
+        const int n = static_cast<int>(ThreadPool::kQueueSize) * 5;
+        for (int i = 0; i < n; ++i) {
+            pool.post([&count](int id) { ++count; });
+        }
+        release = true;
+        wait_for(count, n);
+        REQUIRE( count == n );
+    }
+
+    SECTION("survives a throwing job") {
+        pool.post([](int id) { throw std::runtime_error("fail"); });
+        pool.post([&count](int id) { ++count; });
+        wait_for(count, 1);
+        REQUIRE( count == 1 );
+    }
+
+    SECTION("does not allocate for small jobs") {
+        int *ptr = nullptr;
+        auto job = [&count, ptr](int id) { if (!ptr) ++count; };
+        REQUIRE( ftl::detail::PoolTask::isInline<decltype(job)>() );
+
+        auto allocs = countAllocs([&]() {
+            for (int i = 0; i < 1000; ++i) pool.post(job);
+        });
+
+        REQUIRE( allocs == 0 );
+        wait_for(count, 1000);
+        REQUIRE( count == 1000 );
+    }
+}
+
+TEST_CASE("ThreadPool::stop()", "[pool]") {
+    std::atomic_int count = 0;
+
+    SECTION("waits for queued jobs") {
+        ThreadPool pool(2);
+        for (int i = 0; i < 100; ++i) {
+            pool.post([&count](int id) { sleep_for(milliseconds(1)); ++count; });
+        }
+        pool.stop(true);
+        REQUIRE( count == 100 );
+        REQUIRE( pool.size() == 0 );
+    }
+
+    SECTION("discards queued jobs") {
+        ThreadPool pool(1);
+        std::atomic_bool started = false;
+        pool.post([&started](int id) { started = true; sleep_for(milliseconds(50)); });
+        for (int i = 0; i < 100; ++i) {
+            pool.post([&count](int id) { ++count; });
+        }
+        while (!started) sleep_for(milliseconds(1));
+        pool.stop();
+        REQUIRE( count == 0 );
+        REQUIRE( pool.q_size() == 0 );
+
+        // Posting to a stopped pool drops the job
+        pool.post([&count](int id) { ++count; });
+        REQUIRE( count == 0 );
+    }
+
+    SECTION("can restart") {
+        ThreadPool pool(2);
+        pool.stop(true);
+        pool.restart(3);
+        REQUIRE( pool.size() == 3 );
+        REQUIRE( pool.push([](int id) { return 7; }).get() == 7 );
+    }
+}
+
+// --- Benchmark ---------------------------------------------------------------
+
+// Producer threads submit small jobs concurrently, as network and file
+// threads do for every packet.
+template <typename SUBMIT>
+static double contention(ThreadPool &pool, int producers, int jobs, SUBMIT submit) {
+    std::atomic_int count = 0;
+    const int total = producers * jobs;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < jobs; ++i) submit(pool, count);
+        });
+    }
+    for (auto &t : threads) t.join();
+    while (count < total) std::this_thread::yield();
+    auto stop = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::micro>(stop - start).count() / total;
+}
+
+TEST_CASE("ThreadPool contention", "[pool][performance]") {
+    ThreadPool pool(4);
+    const int jobs = 50000;
+
+    for (int producers : {1, 4, 8}) {
+        double post_us = contention(pool, producers, jobs, [](ThreadPool &p, std::atomic_int &c) {
+            p.post([&c](int id) { ++c; });
+        });
+        double push_us = contention(pool, producers, jobs, [](ThreadPool &p, std::atomic_int &c) {
+            p.push([&c](int id) { ++c; });
+        });
+
+        // Timings are only logged, they vary too much on shared machines
+        LOG(INFO) << "Thread pool, " << producers << " producers: post " << post_us
+                  << " us/job, push " << push_us << " us/job";
+    }
+}
+
+TEST_CASE("ThreadPool post does not allocate", "[pool]") {
+    ThreadPool pool(4);
+
+    // No shared state or future to allocate and synchronise
+    std::atomic_int count = 0;
+    auto post_allocs = countAllocs([&]() {
+        for (int i = 0; i < 1000; ++i) pool.post([&count](int id) { ++count; });
+    });
+    auto push_allocs = countAllocs([&]() {
+        for (int i = 0; i < 1000; ++i) pool.push([&count](int id) { ++count; });
+    });
+    wait_for(count, 2000);
+
+    REQUIRE( post_allocs == 0 );
+    REQUIRE( push_allocs >= 1000 );
+}